@@ -1,7 +1,10 @@
 #include <cmath>
 #include <iostream>
 #include "transvoxel/density.hpp"
+#include "transvoxel/executor.hpp"
 #include "transvoxel/extraction.hpp"
+#include "transvoxel/noise.hpp"
+#include "transvoxel/sdf.hpp"
 #include "transvoxel/structs.hpp"
 #include "transvoxel/voxel_source.hpp"
 
@@ -13,6 +16,18 @@ struct Sphere : public ScalarField<float, float> {
     float get_density(float x, float y, float z) const override {
         return sphere_density(x, y, z);
     }
+
+    // Lets the extraction skip blocks far from the surface after a few samples
+    std::optional<float> lipschitz_constant() const override {
+        return 0.2f;
+    }
+};
+
+template <>
+struct FieldThreading<Sphere> {
+    static constexpr bool thread_safe() {
+        return true;
+    }
 };
 
 const float THRESHOLD = 0.0f;
@@ -45,5 +60,22 @@ int main() {
     mesh = extract_from_field(closure, block, THRESHOLD, into(TransitionSide::LowX));
     std::cout << "Extracted mesh: " << mesh << std::endl;
 
+    // Extract with the density prefetch spread over all cores
+    ThreadExecutor executor;
+    ExtractionOptions options;
+    options.executor = &executor;
+    mesh = extract_from_field(field, block, THRESHOLD, into(TransitionSide::LowX), options);
+    std::cout << "Extracted mesh: " << mesh << std::endl;
+
+    // Extract from a built-in noise field, sampled in batches
+    FractalNoise noise(FractalSettings{ .seed = 1, .frequency = 0.2f, .octaves = 4 });
+    mesh = extract_from_field(noise, block, THRESHOLD, into(TransitionSide::LowX), options);
+    std::cout << "Extracted mesh: " << mesh << std::endl;
+
+    // Extract from a distance tree: a box with a sphere carved out of it
+    SdfField sdf(sdf_subtraction(sdf_box({ 5.0f, 5.0f, 5.0f }, { 4.0f, 4.0f, 4.0f }), sdf_sphere({ 5.0f, 5.0f, 9.0f }, 3.0f)));
+    mesh = extract_from_field(sdf, block, THRESHOLD, into(TransitionSide::LowX), options);
+    std::cout << "Extracted mesh: " << mesh << std::endl;
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+
+// Adaptive sampling against sampling every voxel: the same meshes, bit for bit, from fewer field evaluations
+
+std::atomic<size_t> evaluations(0);
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        evaluations.fetch_add(1, std::memory_order_relaxed);
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+
+    std::optional<float> lipschitz_constant() const override {
+        return 0.2f;
+    }
+};
+
+bool same_mesh(const Mesh<float>& a, const Mesh<float>& b) {
+    return a.positions == b.positions && a.normals == b.normals && a.triangle_indices == b.triangle_indices;
+}
+
+int main() {
+
+    int failures = 0;
+    size_t triangles = 0;
+
+    for (size_t subdivisions : { 7, 24, 31 }) {
+        // Large enough for tiles far from the sphere
+        const Block<float> block({-12.0f, -12.0f, -12.0f}, 24.0f, subdivisions);
+        for (const TransitionSides sides : { no_side(), TransitionSides().set() }) {
+            for (float threshold : { 0.0f, -0.6f, 0.5f }) {
+                ExtractionOptions adaptive;
+                adaptive.adaptive_sampling = true;
+                evaluations = 0;
+                const auto expected = extract_from_field(Sphere{}, block, threshold, sides);
+                const size_t full_evaluations = evaluations;
+                evaluations = 0;
+                const auto mesh = extract_from_field(Sphere{}, block, threshold, sides, adaptive);
+                triangles += expected.triangle_indices.size() / 3;
+                if (!same_mesh(mesh, expected)) {
+                    std::cout << "subdivisions " << subdivisions << ", sides " << sides << ", threshold " << threshold
+                              << ": meshes differ" << std::endl;
+                    ++failures;
+                }
+                if (subdivisions >= 24 && evaluations >= full_evaluations) {
+                    std::cout << "subdivisions " << subdivisions << ", sides " << sides << ", threshold " << threshold
+                              << ": " << evaluations << " evaluations, " << full_evaluations
+                              << " without adaptive sampling" << std::endl;
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    if (triangles == 0) {
+        std::cout << "no surface extracted" << std::endl;
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <vector>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+
+// Batches of blocks against one extraction per block: the same meshes, bit for bit. Adjacent blocks share their
+// voxels and sample fewer of them, blocks along a diagonal fall back to being extracted one by one
+
+std::atomic<size_t> evaluations(0);
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        evaluations.fetch_add(1, std::memory_order_relaxed);
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+bool same_mesh(const Mesh<float>& a, const Mesh<float>& b) {
+    return a.positions == b.positions && a.normals == b.normals && a.triangle_indices == b.triangle_indices;
+}
+
+/**
+Failures of the batch extraction of `blocks`, checking that it samples fewer voxels than one block at a time if
+`shared`, and as many otherwise
+*/
+int check(const char* name, const std::vector<Block<float>>& blocks, const std::vector<TransitionSides>& sides,
+          bool shared) {
+    int failures = 0;
+    evaluations = 0;
+    const auto meshes = extract_many_from_field(Sphere{}, std::span<const Block<float>>(blocks), 0.0f,
+                                                std::span<const TransitionSides>(sides));
+    const size_t batch_evaluations = evaluations;
+    evaluations = 0;
+    size_t triangles = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const auto expected = extract_from_field(Sphere{}, blocks[i], 0.0f, sides[i]);
+        triangles += expected.num_tris();
+        if (!same_mesh(meshes[i], expected)) {
+            std::cout << name << ", block " << i << ", sides " << sides[i] << ": meshes differ" << std::endl;
+            ++failures;
+        }
+    }
+    const size_t single_evaluations = evaluations;
+    if (triangles == 0) {
+        std::cout << name << ": no surface extracted" << std::endl;
+        ++failures;
+    }
+    if (shared ? batch_evaluations >= single_evaluations : batch_evaluations != single_evaluations) {
+        std::cout << name << ": " << batch_evaluations << " evaluations, " << single_evaluations
+                  << " one block at a time" << std::endl;
+        ++failures;
+    }
+    return failures;
+}
+
+int main() {
+
+    int failures = 0;
+
+    // The sphere crosses all the 8 blocks around its center, each with other transition sides
+    {
+        std::vector<Block<float>> blocks;
+        std::vector<TransitionSides> sides;
+        for (size_t i = 0; i < 8; ++i) {
+            const float base[3] = { i & 4 ? 0.0f : -5.0f, i & 2 ? 0.0f : -5.0f, i & 1 ? 0.0f : -5.0f };
+            blocks.emplace_back(std::array<float, 3>{ base[0], base[1], base[2] }, 5.0f, 10);
+            sides.push_back(TransitionSides(i * 9 % 64));
+        }
+        failures += check("2 x 2 x 2 blocks", blocks, sides, true);
+    }
+
+    // Touching by their corners only, in a bounding box too large for a shared lattice
+    {
+        std::vector<Block<float>> blocks;
+        std::vector<TransitionSides> sides;
+        for (size_t i = 0; i < 4; ++i) {
+            const float base = -7.5f + 5.0f * static_cast<float>(i);
+            blocks.emplace_back(std::array<float, 3>{ base, base, base }, 5.0f, 10);
+            sides.push_back(TransitionSides(i * 21 % 64));
+        }
+        failures += check("diagonal", blocks, sides, false);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
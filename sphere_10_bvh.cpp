@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <vector>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/mesh_bvh.hpp"
+#include "transvoxel/structs.hpp"
+
+// The mesh BVH against a brute force loop over all the triangles: the same nearest ray hits, and the same
+// triangles touching spheres, but for rounding right on the boundaries
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+using Vector = std::array<double, 3>;
+
+Vector sub(const Vector& a, const Vector& b) {
+    return { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+}
+
+Vector cross(const Vector& a, const Vector& b) {
+    return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+}
+
+double dot(const Vector& a, const Vector& b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+std::array<Vector, 3> corners(const Mesh<float>& mesh, size_t t) {
+    const Triangle<float> triangle = mesh.triangle(t);
+    std::array<Vector, 3> result;
+    for (size_t corner = 0; corner < 3; ++corner) {
+        const auto& position = triangle.vertices[corner].position;
+        result[corner] = { position[0], position[1], position[2] };
+    }
+    return result;
+}
+
+/**
+Ray parameter of the hit on either side of the triangle, if any
+*/
+std::optional<double> ray_triangle(const std::array<Vector, 3>& triangle, const Vector& origin,
+                                   const Vector& direction) {
+    const Vector ab = sub(triangle[1], triangle[0]);
+    const Vector ac = sub(triangle[2], triangle[0]);
+    const Vector p = cross(direction, ac);
+    const double determinant = dot(ab, p);
+    if (determinant == 0) {
+        return std::nullopt;
+    }
+    const Vector to_origin = sub(origin, triangle[0]);
+    const double u = dot(to_origin, p) / determinant;
+    const Vector q = cross(to_origin, ab);
+    const double v = dot(direction, q) / determinant;
+    const double t = dot(ac, q) / determinant;
+    if (u < 0 || v < 0 || u + v > 1 || t < 0) {
+        return std::nullopt;
+    }
+    return t;
+}
+
+/**
+By the nearest point of the plane of the triangle when inside it, of its edges otherwise
+*/
+double distance_to_triangle(const std::array<Vector, 3>& triangle, const Vector& point) {
+    const Vector normal = cross(sub(triangle[1], triangle[0]), sub(triangle[2], triangle[0]));
+    bool inside = dot(normal, normal) > 0;
+    for (size_t edge = 0; edge < 3 && inside; ++edge) {
+        const Vector& a = triangle[edge];
+        const Vector& b = triangle[(edge + 1) % 3];
+        inside = dot(cross(sub(b, a), sub(point, a)), normal) >= 0;
+    }
+    if (inside) {
+        return std::abs(dot(sub(point, triangle[0]), normal)) / std::sqrt(dot(normal, normal));
+    }
+    double nearest = std::numeric_limits<double>::max();
+    for (size_t edge = 0; edge < 3; ++edge) {
+        const Vector& a = triangle[edge];
+        const Vector ab = sub(triangle[(edge + 1) % 3], a);
+        const double length = dot(ab, ab);
+        const double t = length == 0 ? 0 : std::clamp(dot(sub(point, a), ab) / length, 0.0, 1.0);
+        const Vector d = sub(point, { a[0] + t * ab[0], a[1] + t * ab[1], a[2] + t * ab[2] });
+        nearest = std::min(nearest, std::sqrt(dot(d, d)));
+    }
+    return nearest;
+}
+
+int main() {
+
+    constexpr double TOLERANCE = 1e-4;
+    ExtractionOptions options;
+    options.build_bvh = true;
+    const Block<float> block({-6.0f, -6.0f, -6.0f}, 12.0f, 17);
+    const Mesh<float> mesh = extract_from_field(Sphere{}, block, 0.0f, TransitionSides().set(0).set(3), options);
+    int failures = 0;
+    if (!mesh.bvh || mesh.num_tris() == 0) {
+        std::cout << "no BVH built" << std::endl;
+        return 1;
+    }
+    std::vector<std::array<Vector, 3>> triangles;
+    for (size_t t = 0; t < mesh.num_tris(); ++t) {
+        triangles.push_back(corners(mesh, t));
+    }
+
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> coordinate(-8.0f, 8.0f);
+    size_t hits = 0;
+    for (size_t ray = 0; ray < 2000; ++ray) {
+        const std::array<float, 3> origin = { coordinate(random), coordinate(random), coordinate(random) };
+        const std::array<float, 3> target = { coordinate(random), coordinate(random), coordinate(random) };
+        std::array<float, 3> direction;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            direction[axis] = target[axis] - origin[axis];
+        }
+        // Half of the rays stop at their target, before some of the surface
+        const float max_distance = ray % 2 == 0 ? 1.0f : std::numeric_limits<float>::max();
+        const Vector o = { origin[0], origin[1], origin[2] };
+        const Vector d = { direction[0], direction[1], direction[2] };
+        std::optional<double> nearest;
+        for (const auto& triangle : triangles) {
+            const auto t = ray_triangle(triangle, o, d);
+            if (t && *t <= max_distance && (!nearest || *t < *nearest)) {
+                nearest = t;
+            }
+        }
+        const auto hit = mesh.bvh->raycast(mesh, origin, direction, max_distance);
+        // Hits right at the end of the ray may go either way
+        const bool borderline = nearest && std::abs(*nearest - max_distance) < TOLERANCE;
+        if (hit.has_value() != nearest.has_value() && !borderline) {
+            std::cout << "ray " << ray << ": " << (hit ? "hit" : "no hit") << ", brute force "
+                      << (nearest ? "hit" : "no hit") << std::endl;
+            ++failures;
+        } else if (hit && nearest && std::abs(hit->distance - *nearest) > TOLERANCE) {
+            std::cout << "ray " << ray << ": hit at " << hit->distance << ", brute force " << *nearest << std::endl;
+            ++failures;
+        } else if (hit) {
+            // Unless it only grazes the triangle reported
+            const auto own = ray_triangle(triangles[hit->triangle], o, d);
+            if (own && std::abs(*own - hit->distance) > TOLERANCE) {
+                std::cout << "ray " << ray << ": triangle " << hit->triangle << " not at the hit" << std::endl;
+                ++failures;
+            }
+        }
+        hits += hit ? 1 : 0;
+    }
+    if (hits < 200) {
+        std::cout << "only " << hits << " rays hit" << std::endl;
+        ++failures;
+    }
+
+    std::uniform_real_distribution<float> radius(0.1f, 3.0f);
+    size_t found = 0;
+    for (size_t query = 0; query < 500; ++query) {
+        const std::array<float, 3> center = { coordinate(random), coordinate(random), coordinate(random) };
+        const float r = radius(random);
+        std::vector<uint32_t> result;
+        mesh.bvh->triangles_in_sphere(mesh, center, r, result);
+        std::sort(result.begin(), result.end());
+        if (std::adjacent_find(result.begin(), result.end()) != result.end()) {
+            std::cout << "sphere " << query << ": triangles found twice" << std::endl;
+            ++failures;
+        }
+        for (uint32_t t = 0; t < triangles.size(); ++t) {
+            const double distance = distance_to_triangle(triangles[t], { center[0], center[1], center[2] });
+            const bool reported = std::binary_search(result.begin(), result.end(), t);
+            if (std::abs(distance - r) > TOLERANCE && reported != (distance < r)) {
+                std::cout << "sphere " << query << ": triangle " << t << " at " << distance << " of radius " << r
+                          << (reported ? " reported" : " missed") << std::endl;
+                ++failures;
+            }
+        }
+        found += result.size();
+    }
+    if (found == 0) {
+        std::cout << "no triangle touching any sphere" << std::endl;
+        ++failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "transvoxel/density.hpp"
+#include "transvoxel/mesh_cache.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/voxel_source.hpp"
+
+// Cache hits and misses of `extract_cached`: the key covers the options that change the mesh, and the field version
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+const float THRESHOLD = 0.0f;
+
+int main() {
+
+    const Block<float> block({0.0f, 0.0f, 0.0f}, 10.0f, 10);
+    WorldMappingVoxelSource<float, float, Sphere> source(Sphere{}, block);
+    MeshCache<float, float> cache(size_t(1) << 30);
+    int failures = 0;
+
+    auto lookup = [&](const char* name, uint64_t field_version, const ExtractionOptions& options, bool expect_hit) {
+        const MeshCacheStats before = cache.stats();
+        auto mesh = extract_cached(cache, field_version, source, block, THRESHOLD, into(TransitionSide::LowX), options);
+        const bool hit = cache.stats().hits > before.hits;
+        if (hit != expect_hit) {
+            std::cout << name << ": expected a " << (expect_hit ? "hit" : "miss") << std::endl;
+            ++failures;
+        }
+        return mesh;
+    };
+
+    const ExtractionOptions plain;
+    const auto first = lookup("first extraction", 1, plain, false);
+    if (lookup("same key", 1, plain, true) != first) {
+        std::cout << "same key: another mesh returned" << std::endl;
+        ++failures;
+    }
+
+    // Adaptive sampling gives the same mesh, so shares the entry
+    ExtractionOptions adaptive;
+    adaptive.adaptive_sampling = true;
+    lookup("adaptive sampling", 1, adaptive, true);
+
+    ExtractionOptions optimized;
+    optimized.optimize_for_rendering = true;
+    lookup("optimize_for_rendering", 1, optimized, false);
+    ExtractionOptions meshlets;
+    meshlets.build_meshlets = true;
+    lookup("build_meshlets", 1, meshlets, false);
+    ExtractionOptions bvh;
+    bvh.build_bvh = true;
+    const auto with_bvh = lookup("build_bvh", 1, bvh, false);
+    if (!with_bvh->bvh) {
+        std::cout << "build_bvh: mesh without a BVH" << std::endl;
+        ++failures;
+    }
+    ExtractionOptions fast;
+    fast.fast_normals = true;
+    lookup("fast_normals", 1, fast, false);
+    ExtractionOptions tiled;
+    tiled.cache_layout = DensityCacheLayout::Tiled;
+    lookup("cache_layout", 1, tiled, false);
+    lookup("build_bvh again", 1, bvh, true);
+
+    // A new field version misses, and invalidating drops the old entries
+    lookup("new field version", 2, plain, false);
+    cache.invalidate_up_to(1);
+    lookup("invalidated version", 1, plain, false);
+    lookup("kept version", 2, plain, true);
+
+    if (failures != 0) {
+        std::cout << failures << " failures" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+
+// Compact densities against float: the same triangles, with vertices within the quantization of the densities
+
+float sphere_density(float x, float y, float z) {
+    return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+}
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return sphere_density(x, y, z);
+    }
+};
+
+/**
+The sphere density times `scale`, rounded to the nearest value of Q
+*/
+template <typename Q>
+struct CompactSphere : public ScalarField<Q, float> {
+    float scale;
+
+    CompactSphere(float scale) : scale(scale) {}
+
+    Q get_density(float x, float y, float z) const override {
+        const float value = sphere_density(x, y, z) * scale;
+        if constexpr (std::is_integral_v<Q>) {
+            const float lowest = static_cast<float>(std::numeric_limits<Q>::lowest());
+            const float highest = static_cast<float>(std::numeric_limits<Q>::max());
+            return static_cast<Q>(std::clamp(std::round(value), lowest, highest));
+        } else {
+            return static_cast<Q>(value);
+        }
+    }
+};
+
+template <typename Q>
+int check(const char* name, float scale, float tolerance) {
+    const Block<float> block({0.0f, 0.0f, 0.0f}, 10.0f, 10);
+    const TransitionSides sides = TransitionSides().set();
+    const auto expected = extract_from_field(Sphere{}, block, 0.0f, sides);
+    const auto mesh = extract_from_field(CompactSphere<Q>(scale), block, Q(0), sides);
+
+    if (expected.triangle_indices.empty()) {
+        std::cout << name << ": empty reference mesh" << std::endl;
+        return 1;
+    }
+    if (mesh.triangle_indices != expected.triangle_indices || mesh.positions.size() != expected.positions.size()) {
+        std::cout << name << ": " << mesh.triangle_indices.size() / 3 << " triangles, expected "
+                  << expected.triangle_indices.size() / 3 << std::endl;
+        return 1;
+    }
+    float largest = 0.0f;
+    for (size_t i = 0; i < mesh.positions.size(); ++i) {
+        largest = std::max(largest, std::abs(mesh.positions[i] - expected.positions[i]));
+    }
+    if (largest > tolerance) {
+        std::cout << name << ": positions off by " << largest << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    int failures = 0;
+    failures += check<int8_t>("int8", 100.0f, 0.05f);
+    failures += check<int16_t>("int16", 20000.0f, 0.001f);
+#if defined(__FLT16_MAX__)
+    failures += check<_Float16>("half", 1.0f, 0.001f);
+#endif
+    return failures == 0 ? 0 : 1;
+}
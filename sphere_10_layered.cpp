@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/voxel_source.hpp"
+
+// Layered meshes assembled for some transition sides against extractions with these sides: the same triangles,
+// normals and positions, but for the vertices in the cells along a block edge between a transition side and a side
+// without one, which keep their primary position when assembled. Those only move within their cell
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+/**
+The `TransitionSides` bits of the block faces within one cell of `position`
+*/
+TransitionSides faces_near(const Block<float>& block, const float* position) {
+    const float cell = block.dims.size / static_cast<float>(block.subdivisions);
+    TransitionSides faces;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        const float low = block.dims.base[axis];
+        faces.set(2 * axis, position[axis] - low <= cell);
+        faces.set(2 * axis + 1, low + block.dims.size - position[axis] <= cell);
+    }
+    return faces;
+}
+
+int main() {
+
+    int failures = 0;
+    // Off center, so that the sphere crosses the block edges, with the sides of one corner inside the sphere
+    const Block<float> block({-1.0f, -2.0f, -3.0f}, 6.0f, 10);
+    const auto layered = extract_layered(WorldMappingVoxelSource<float, float, Sphere>(Sphere{}, block), block, 0.0f);
+    size_t moved = 0;
+
+    for (const TransitionSides sides : { no_side(), TransitionSides(0b000001), TransitionSides(0b000010),
+                                         TransitionSides(0b010101), TransitionSides(0b101001),
+                                         TransitionSides(0b111110), TransitionSides().set() }) {
+        const auto assembled = layered.assemble(sides);
+        const auto expected = extract_from_field(Sphere{}, block, 0.0f, sides);
+        if (expected.triangle_indices.empty() || assembled.triangle_indices != expected.triangle_indices
+            || assembled.normals != expected.normals || assembled.positions.size() != expected.positions.size()) {
+            std::cout << "sides " << sides << ": different triangles" << std::endl;
+            ++failures;
+            continue;
+        }
+        for (size_t v = 0; v < assembled.positions.size() / 3; ++v) {
+            const float* position = &assembled.positions[3 * v];
+            if (position[0] == expected.positions[3 * v] && position[1] == expected.positions[3 * v + 1]
+                && position[2] == expected.positions[3 * v + 2]) {
+                continue;
+            }
+            const TransitionSides faces = faces_near(block, position);
+            float distance = 0.0f;
+            for (size_t axis = 0; axis < 3; ++axis) {
+                distance = std::max(distance, std::abs(position[axis] - expected.positions[3 * v + axis]));
+            }
+            if ((faces & sides).none() || (faces & ~sides).none()
+                || distance > block.dims.size / static_cast<float>(block.subdivisions)) {
+                std::cout << "sides " << sides << ": vertex " << v << " at " << position[0] << " " << position[1]
+                          << " " << position[2] << " moved by " << distance << ", near faces " << faces << std::endl;
+                ++failures;
+            }
+            ++moved;
+        }
+    }
+
+    // Else the difference allowed is not exercised
+    if (moved == 0) {
+        std::cout << "no vertex near a block edge" << std::endl;
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+
+// The tiled density cache layout against the linear one: the same triangles, in another order
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+using CornerData = std::array<float, 6>;
+using TriangleData = std::array<CornerData, 3>;
+
+/**
+Triangles by their corner positions and normals, each one starting from its smallest corner without changing its
+winding, in sorted order
+*/
+std::vector<TriangleData> sorted_triangles(const Mesh<float>& mesh) {
+    std::vector<TriangleData> triangles;
+    for (size_t t = 0; t + 2 < mesh.triangle_indices.size(); t += 3) {
+        TriangleData triangle;
+        for (size_t corner = 0; corner < 3; ++corner) {
+            const size_t vertex = mesh.triangle_indices[t + corner];
+            for (size_t axis = 0; axis < 3; ++axis) {
+                triangle[corner][axis] = mesh.positions[3 * vertex + axis];
+                triangle[corner][3 + axis] = mesh.normals[3 * vertex + axis];
+            }
+        }
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int main() {
+
+    int failures = 0;
+
+    for (size_t subdivisions : { 3, 10, 17 }) {
+        const Block<float> block({-6.0f, -6.0f, -6.0f}, 12.0f, subdivisions);
+        for (const TransitionSides sides : { no_side(), TransitionSides().set(0).set(5), TransitionSides().set() }) {
+            ExtractionOptions linear;
+            ExtractionOptions tiled;
+            tiled.cache_layout = DensityCacheLayout::Tiled;
+            const auto expected = extract_from_field(Sphere{}, block, 0.0f, sides, linear);
+            const auto mesh = extract_from_field(Sphere{}, block, 0.0f, sides, tiled);
+            if (expected.triangle_indices.empty() || mesh.positions.size() != expected.positions.size() ||
+                sorted_triangles(mesh) != sorted_triangles(expected)) {
+                std::cout << "subdivisions " << subdivisions << ", sides " << sides << ": meshes differ" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/voxel_source.hpp"
+
+// Several thresholds from one sampling pass against one extraction per threshold: the same meshes, bit for bit
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+
+    // Lets the adaptive sampling put placeholders far from the surfaces
+    std::optional<float> lipschitz_constant() const override {
+        return 0.2f;
+    }
+};
+
+bool same_mesh(const Mesh<float>& a, const Mesh<float>& b) {
+    return a.positions == b.positions && a.normals == b.normals && a.triangle_indices == b.triangle_indices;
+}
+
+int main() {
+
+    const float thresholds[] = { 0.0f, -0.6f, 0.5f, 0.0f };
+    int failures = 0;
+    size_t triangles = 0;
+
+    for (size_t subdivisions : { 7, 24, 31 }) {
+        // Large enough for the adaptive sampling to put placeholders in the corners
+        const Block<float> block({-12.0f, -12.0f, -12.0f}, 24.0f, subdivisions);
+        for (const TransitionSides sides : { no_side(), TransitionSides().set() }) {
+            for (bool adaptive : { false, true }) {
+                ExtractionOptions options;
+                options.adaptive_sampling = adaptive;
+                WorldMappingVoxelSource<float, float, Sphere> source(Sphere{}, block);
+                const auto meshes = extract_multi(source, block, std::span<const float>(thresholds), sides, options);
+                for (size_t i = 0; i < std::size(thresholds); ++i) {
+                    const auto expected = extract_from_field(Sphere{}, block, thresholds[i], sides, options);
+                    triangles += expected.triangle_indices.size() / 3;
+                    if (!same_mesh(meshes[i], expected)) {
+                        std::cout << "subdivisions " << subdivisions << ", sides " << sides << ", adaptive "
+                                  << adaptive << ", threshold " << thresholds[i] << ": meshes differ" << std::endl;
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    if (triangles == 0) {
+        std::cout << "no surface extracted" << std::endl;
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
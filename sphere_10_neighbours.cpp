@@ -0,0 +1,81 @@
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/voxel_source.hpp"
+
+// Transition voxels read from the finer blocks across each side against sampling them from the field: the same
+// meshes, bit for bit, and the face voxels of those sides not sampled again
+
+std::atomic<size_t> evaluations(0);
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        evaluations.fetch_add(1, std::memory_order_relaxed);
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+using Cache = PreCachingVoxelSource<float, WorldMappingVoxelSource<float, float, Sphere>>;
+
+bool same_mesh(const Mesh<float>& a, const Mesh<float>& b) {
+    return a.positions == b.positions && a.normals == b.normals && a.triangle_indices == b.triangle_indices;
+}
+
+int main() {
+
+    int failures = 0;
+    // Sizes and positions in powers of two, so that the finer blocks put their voxels at the very same positions
+    constexpr size_t SUBDIVISIONS = 8;
+    constexpr float SIZE = 8.0f;
+    const Block<float> block({-4.0f, -4.0f, -4.0f}, SIZE, SUBDIVISIONS);
+
+    for (size_t side = 0; side < 6; ++side) {
+        // Sides are low X, high X, low Y, high Y, low Z, high Z
+        const size_t axis = side / 2;
+        std::array<float, 3> neighbour_base = block.dims.base;
+        neighbour_base[axis] += side % 2 == 0 ? -SIZE : SIZE;
+
+        std::array<std::shared_ptr<Cache>, 8> caches;
+        std::array<const Cache*, 8> finer;
+        for (size_t i = 0; i < 8; ++i) {
+            const Block<float> finer_block({ neighbour_base[0] + (i & 4 ? SIZE / 2 : 0.0f),
+                                             neighbour_base[1] + (i & 2 ? SIZE / 2 : 0.0f),
+                                             neighbour_base[2] + (i & 1 ? SIZE / 2 : 0.0f) },
+                                           SIZE / 2, SUBDIVISIONS);
+            caches[i] = make_voxel_cache<float>(
+                WorldMappingVoxelSource<float, float, Sphere>(Sphere{}, finer_block), finer_block);
+            caches[i]->load_regular_block_voxels();
+            finer[i] = caches[i].get();
+        }
+        const FinerBlocksVoxels<float, Cache> neighbour(finer, SUBDIVISIONS);
+        std::array<const NeighbourVoxelSource<float>*, 6> neighbours{};
+        neighbours[side] = &neighbour;
+
+        // With the side alone, and with all of them, the others sampled from the field
+        for (const TransitionSides sides : { TransitionSides().set(side), TransitionSides().set() }) {
+            evaluations = 0;
+            const auto expected = extract_from_field(Sphere{}, block, 0.0f, sides);
+            const size_t field_evaluations = evaluations;
+            evaluations = 0;
+            const auto mesh = extract_with_neighbours(WorldMappingVoxelSource<float, float, Sphere>(Sphere{}, block),
+                                                      block, 0.0f, sides, neighbours);
+            if (expected.triangle_indices.empty() || !same_mesh(mesh, expected)) {
+                std::cout << "neighbours on side " << side << ", sides " << sides << ": meshes differ" << std::endl;
+                ++failures;
+            }
+            if (evaluations >= field_evaluations) {
+                std::cout << "neighbours on side " << side << ", sides " << sides << ": " << evaluations
+                          << " evaluations, " << field_evaluations << " without neighbours" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "transvoxel/noise.hpp"
+
+// Noise batches against single points: the same bits, for every kind of noise, at every batch length. Built with
+// fused multiply-adds allowed, which must not change the single points either
+
+const char* kind_name(NoiseKind kind) {
+    switch (kind) {
+    case NoiseKind::Gradient:
+        return "gradient";
+    case NoiseKind::Simplex:
+        return "simplex";
+    case NoiseKind::Fractal:
+        return "fractal";
+    case NoiseKind::Ridged:
+        return "ridged";
+    }
+    return "unknown";
+}
+
+int main() {
+
+    // Points of the 11 x 11 x 11 lattice of a 10 unit block, shifted off the integers
+    std::vector<float> x, y, z;
+    for (size_t i = 0; i <= 10; ++i) {
+        for (size_t j = 0; j <= 10; ++j) {
+            for (size_t k = 0; k <= 10; ++k) {
+                x.push_back(static_cast<float>(i) - 5.3f);
+                y.push_back(static_cast<float>(j) * 1.7f - 8.1f);
+                z.push_back(static_cast<float>(k) * 0.9f + 2.6f);
+            }
+        }
+    }
+    FractalSettings settings;
+    settings.seed = 1337;
+    settings.frequency = 0.37f;
+    int failures = 0;
+
+    for (NoiseKind kind : { NoiseKind::Gradient, NoiseKind::Simplex, NoiseKind::Fractal, NoiseKind::Ridged }) {
+        const NoiseField field(kind, settings);
+        std::vector<float> expected(x.size());
+        bool varies = false;
+        for (size_t i = 0; i < x.size(); ++i) {
+            expected[i] = field.get_density(x[i], y[i], z[i]);
+            varies = varies || expected[i] != expected[0];
+        }
+        if (!varies) {
+            std::cout << kind_name(kind) << ": constant noise" << std::endl;
+            ++failures;
+        }
+        // Lengths that leave every possible tail after the widest lanes
+        for (size_t count : { x.size(), size_t(1), size_t(7), size_t(17), size_t(31) }) {
+            std::vector<float> batch(count);
+            field.get_densities(x.data(), y.data(), z.data(), batch.data(), count);
+            if (std::memcmp(batch.data(), expected.data(), count * sizeof(float)) != 0) {
+                std::cout << kind_name(kind) << ", " << count << " points: batch differs" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <random>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/voxel_query.hpp"
+
+// Voxel queries on a cache loaded with adaptive sampling against the analytic sphere: the placeholders far from
+// the surface are sampled before the first query, and densities, solids, normals and ray hits follow the sphere
+
+constexpr float RADIUS = 5.0f;
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / RADIUS;
+    }
+
+    std::optional<float> lipschitz_constant() const override {
+        return 0.2f;
+    }
+};
+
+using Cache = PreCachingVoxelSource<float, WorldMappingVoxelSource<float, float, Sphere>>;
+
+float length(const std::array<float, 3>& v) {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+/**
+Failures of the queries of `query`, over the voxels of `block`
+*/
+template <typename V>
+int check(const char* name, const VoxelQuery<float, V>& query, const Block<float>& block) {
+    int failures = 0;
+    const Sphere sphere;
+
+    // At the voxels, the densities sampled
+    const float step = block.dims.size / static_cast<float>(block.subdivisions);
+    for (size_t x = 0; x <= block.subdivisions; ++x) {
+        for (size_t y = 0; y <= block.subdivisions; ++y) {
+            for (size_t z = 0; z <= block.subdivisions; ++z) {
+                const std::array<float, 3> p = { block.dims.base[0] + step * static_cast<float>(x),
+                                                 block.dims.base[1] + step * static_cast<float>(y),
+                                                 block.dims.base[2] + step * static_cast<float>(z) };
+                const float expected = sphere.get_density(p[0], p[1], p[2]);
+                if (std::abs(query.density(p) - expected) > 1e-5f) {
+                    std::cout << name << ": density " << query.density(p) << " at " << p[0] << " " << p[1] << " "
+                              << p[2] << ", expected " << expected << std::endl;
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    std::mt19937 random(2024);
+    std::uniform_real_distribution<float> coordinate(-11.0f, 11.0f);
+    std::normal_distribution<float> gaussian;
+    for (size_t sample = 0; sample < 1000; ++sample) {
+        // Away from the surface, inside the sphere is solid
+        const std::array<float, 3> p = { coordinate(random), coordinate(random), coordinate(random) };
+        const float r = length(p);
+        if (std::abs(r - RADIUS) > 0.5f && query.solid(p) != (r < RADIUS)) {
+            std::cout << name << ": solid " << query.solid(p) << " at radius " << r << std::endl;
+            ++failures;
+        }
+
+        // On the surface, normals point away from the center, and rays toward it hit the surface
+        std::array<float, 3> direction = { gaussian(random), gaussian(random), gaussian(random) };
+        const float norm = length(direction);
+        for (float& d : direction) {
+            d /= norm;
+        }
+        const std::array<float, 3> on_surface = { direction[0] * RADIUS, direction[1] * RADIUS,
+                                                  direction[2] * RADIUS };
+        const auto normal = query.normal(on_surface);
+        const float alignment = normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2];
+        if (alignment < 0.95f) {
+            std::cout << name << ": normal off by " << std::acos(alignment) << " radians" << std::endl;
+            ++failures;
+        }
+
+        // Interpolating between voxels one unit apart moves the surface by up to a tenth of a unit
+        constexpr float START = 11.0f;
+        const std::array<float, 3> origin = { direction[0] * START, direction[1] * START, direction[2] * START };
+        const auto hit = query.raycast(origin, { -direction[0], -direction[1], -direction[2] });
+        if (!hit || std::abs(hit->distance - (START - RADIUS)) > 0.1f) {
+            std::cout << name << ": ray from radius " << START << " hit at "
+                      << (hit ? hit->distance : -1.0f) << ", expected " << START - RADIUS << std::endl;
+            ++failures;
+        } else if (std::abs(length(hit->position) - RADIUS) > 0.1f) {
+            std::cout << name << ": hit at radius " << length(hit->position) << std::endl;
+            ++failures;
+        }
+    }
+
+    // Tangent to a sphere around the surface, and stopping short of the surface
+    if (query.raycast({ -11.0f, 6.0f, 0.0f }, { 1.0f, 0.0f, 0.0f })) {
+        std::cout << name << ": ray passing the sphere hit it" << std::endl;
+        ++failures;
+    }
+    if (query.raycast({ 0.0f, 0.0f, -11.0f }, { 0.0f, 0.0f, 1.0f }, 5.5f)) {
+        std::cout << name << ": ray stopping before the sphere hit it" << std::endl;
+        ++failures;
+    }
+    return failures;
+}
+
+int main() {
+
+    int failures = 0;
+    // Large enough for tiles of placeholders far from the sphere
+    const Block<float> block({-12.0f, -12.0f, -12.0f}, 24.0f, 24);
+    ExtractionOptions adaptive;
+    adaptive.adaptive_sampling = true;
+    const auto cache = make_voxel_cache<float>(WorldMappingVoxelSource<float, float, Sphere>(Sphere{}, block), block,
+                                               adaptive);
+    extract(cache, block, 0.0f, no_side(), adaptive);
+    if (cache->placeholder_tiles.empty()) {
+        std::cout << "no placeholders to sample" << std::endl;
+        ++failures;
+    }
+
+    const DenseVoxelChunk<float> chunk = DenseVoxelChunk<float>::from_source(*cache, block.subdivisions);
+    failures += check("chunk", VoxelQuery<float, DenseVoxelChunk<float>>(chunk, block), block);
+
+    const auto other = make_voxel_cache<float>(WorldMappingVoxelSource<float, float, Sphere>(Sphere{}, block), block,
+                                               adaptive);
+    extract(other, block, 0.0f, no_side(), adaptive);
+    failures += check("cache", VoxelQuery<float, Cache>(*other, block), block);
+    if (!other->placeholder_tiles.empty()) {
+        std::cout << "placeholders left after the query" << std::endl;
+        ++failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
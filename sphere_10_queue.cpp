@@ -0,0 +1,126 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/extraction_queue.hpp"
+#include "transvoxel/structs.hpp"
+
+// The extraction queue on one worker: jobs run lowest priority value first, reprioritized jobs move, cancelled
+// queued jobs never run and give no mesh, and a running job stops at its next cancellation point
+
+std::atomic<size_t> evaluations(0);
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        evaluations.fetch_add(1, std::memory_order_relaxed);
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+};
+
+const Block<float> block({-6.0f, -6.0f, -6.0f}, 12.0f, 10);
+
+int main() {
+
+    int failures = 0;
+    const Mesh<float> expected = extract_from_field(Sphere{}, block, 0.0f, TransitionSides().set());
+
+    {
+        ExtractionQueue<float> queue(1);
+        // Keeps the worker busy while the others are queued
+        std::promise<void> started;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        const auto blocker = queue.submit_task([&started, released](const ExtractionOptions&) {
+            started.set_value();
+            released.wait();
+            return Mesh<float>();
+        }, 0.0f);
+        started.get_future().wait();
+
+        std::mutex order_mutex;
+        std::vector<char> order;
+        const auto job = [&](char name, float priority) {
+            return queue.submit_task([&, name](const ExtractionOptions& options) {
+                {
+                    std::lock_guard<std::mutex> lock(order_mutex);
+                    order.push_back(name);
+                }
+                return extract_from_field(Sphere{}, block, 0.0f, TransitionSides().set(), options);
+            }, priority);
+        };
+        const auto a = job('a', 5.0f);
+        const auto b = job('b', 1.0f);
+        const auto c = job('c', 3.0f);
+        const auto d = job('d', 2.0f);
+        const auto e = job('e', 4.0f);
+        queue.cancel(c);
+        // Now ahead of b
+        queue.reprioritize(d, 0.5f);
+        if (queue.reprioritize(c, 0.0f) || queue.pending() != 4) {
+            std::cout << "cancelled job still queued" << std::endl;
+            ++failures;
+        }
+        release.set_value();
+
+        for (const auto& [name, handle] : { std::pair{ 'a', a }, std::pair{ 'b', b }, std::pair{ 'd', d },
+                                            std::pair{ 'e', e } }) {
+            const auto mesh = handle.result.get();
+            if (!mesh || mesh->triangle_indices != expected.triangle_indices) {
+                std::cout << "job " << name << ": wrong mesh" << std::endl;
+                ++failures;
+            }
+        }
+        if (c.result.get()) {
+            std::cout << "cancelled job gave a mesh" << std::endl;
+            ++failures;
+        }
+        if (!blocker.result.get() || queue.reprioritize(a, 0.0f)) {
+            std::cout << "finished jobs mishandled" << std::endl;
+            ++failures;
+        }
+        if (order != std::vector<char>{ 'd', 'b', 'e', 'a' }) {
+            std::cout << "jobs ran in order " << std::string(order.begin(), order.end()) << ", expected dbea"
+                      << std::endl;
+            ++failures;
+        }
+    }
+
+    {
+        ExtractionQueue<float> queue(1);
+        evaluations = 0;
+        extract_from_field(Sphere{}, block, 0.0f, TransitionSides().set());
+        const size_t full_evaluations = evaluations;
+
+        // The job waits to be cancelled before extracting, which must then stop before the transition cells
+        std::promise<void> started;
+        const auto running = queue.submit_task([&started](const ExtractionOptions& options) {
+            started.set_value();
+            while (!options.cancelled->load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            evaluations = 0;
+            return extract_from_field(Sphere{}, block, 0.0f, TransitionSides().set(), options);
+        }, 0.0f);
+        started.get_future().wait();
+        queue.cancel(running);
+        if (running.result.get()) {
+            std::cout << "cancelled running job gave a mesh" << std::endl;
+            ++failures;
+        }
+        if (evaluations >= full_evaluations) {
+            std::cout << "cancelled running job sampled " << evaluations << " voxels, "
+                      << full_evaluations << " for a whole extraction" << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
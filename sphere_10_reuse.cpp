@@ -0,0 +1,113 @@
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "transvoxel/density.hpp"
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/voxel_source.hpp"
+
+// Extractions from a voxel cache kept across them against fresh extractions: the same meshes, bit for bit,
+// whatever the previous extractions loaded, and when several threads share the cache. Once everything is loaded,
+// extracting again samples nothing
+
+std::atomic<size_t> evaluations(0);
+
+struct Sphere : public ScalarField<float, float> {
+    float get_density(float x, float y, float z) const override {
+        evaluations.fetch_add(1, std::memory_order_relaxed);
+        return 1.0f - std::sqrt(x * x + y * y + z * z) / 5.0f;
+    }
+
+    // Lets the adaptive sampling put placeholders far from the surfaces
+    std::optional<float> lipschitz_constant() const override {
+        return 0.2f;
+    }
+};
+
+using Source = WorldMappingVoxelSource<float, float, Sphere>;
+
+bool same_mesh(const Mesh<float>& a, const Mesh<float>& b) {
+    return a.positions == b.positions && a.normals == b.normals && a.triangle_indices == b.triangle_indices;
+}
+
+struct Request {
+    float threshold;
+    TransitionSides sides;
+    bool adaptive;
+};
+
+int main() {
+
+    const Block<float> block({-12.0f, -12.0f, -12.0f}, 24.0f, 24);
+    // Narrow adaptive ranges first, so that later extractions sample placeholders
+    const Request requests[] = {
+        { 0.0f, no_side(), true },
+        { 0.0f, TransitionSides().set(0).set(3), true },
+        { -0.6f, TransitionSides().set(1), true },
+        { 0.5f, TransitionSides().set(), false },
+        { 0.0f, no_side(), false },
+    };
+    int failures = 0;
+
+    for (DensityCacheLayout layout : { DensityCacheLayout::Linear, DensityCacheLayout::Tiled }) {
+        ExtractionOptions cache_options;
+        cache_options.cache_layout = layout;
+        const auto cache = make_voxel_cache<float>(Source(Sphere{}, block), block, cache_options);
+        for (const Request& request : requests) {
+            ExtractionOptions options = cache_options;
+            options.adaptive_sampling = request.adaptive;
+            const auto mesh = extract(cache, block, request.threshold, request.sides, options);
+            const auto expected = extract_from_field(Sphere{}, block, request.threshold, request.sides, options);
+            if (expected.triangle_indices.empty() || !same_mesh(mesh, expected)) {
+                std::cout << "layout " << static_cast<int>(layout) << ", threshold " << request.threshold
+                          << ", sides " << request.sides << ", adaptive " << request.adaptive
+                          << ": meshes differ" << std::endl;
+                ++failures;
+            }
+        }
+        // Everything is loaded by now: all sides, and all thresholds without adaptive sampling
+        evaluations = 0;
+        for (const Request& request : requests) {
+            ExtractionOptions options = cache_options;
+            options.adaptive_sampling = request.adaptive;
+            extract(cache, block, request.threshold, request.sides, options);
+        }
+        if (evaluations != 0) {
+            std::cout << "layout " << static_cast<int>(layout) << ": " << evaluations
+                      << " evaluations extracting again" << std::endl;
+            ++failures;
+        }
+    }
+
+    // All the requests at once, on threads sharing a cache loaded adaptively
+    ExtractionOptions adaptive;
+    adaptive.adaptive_sampling = true;
+    const auto cache = make_voxel_cache<float>(Source(Sphere{}, block), block, adaptive);
+    extract(cache, block, 0.0f, no_side(), adaptive);
+    std::vector<Mesh<float>> meshes(std::size(requests));
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::size(requests); ++i) {
+        threads.emplace_back([&, i] {
+            ExtractionOptions options;
+            options.adaptive_sampling = requests[i].adaptive;
+            meshes[i] = extract(cache, block, requests[i].threshold, requests[i].sides, options);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < std::size(requests); ++i) {
+        const auto expected = extract_from_field(Sphere{}, block, requests[i].threshold, requests[i].sides);
+        if (!same_mesh(meshes[i], expected)) {
+            std::cout << "shared cache, request " << i << ": meshes differ" << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
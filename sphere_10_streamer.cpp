@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <thread>
+#include "transvoxel/extraction.hpp"
+#include "transvoxel/noise.hpp"
+#include "transvoxel/structs.hpp"
+#include "transvoxel/world_streamer.hpp"
+
+// Streaming around moving viewers: within the memory budget and the completions per update at every update, no
+// hole left once the viewers stop, and the visible meshes the same, bit for bit, as extractions of their blocks
+// with the same transition sides
+
+using Streamer = WorldStreamer<float, float, GradientNoise>;
+
+const GradientNoise field(7, 0.05f);
+const float threshold = 0.0f;
+
+StreamingSettings<float> settings(size_t memory_budget) {
+    StreamingSettings<float> result;
+    result.block_size = 8;
+    result.subdivisions = 8;
+    result.lod_levels = 3;
+    result.view_distance = 40;
+    result.memory_budget = memory_budget;
+    result.max_completions_per_update = 4;
+    result.workers = 2;
+    return result;
+}
+
+bool same_mesh(const Mesh<float>& a, const Mesh<float>& b) {
+    return a.positions == b.positions && a.normals == b.normals && a.triangle_indices == b.triangle_indices;
+}
+
+/**
+One update, checking the limits it must keep to. Returns the number of failures
+*/
+int update(Streamer& streamer, std::span<const StreamingViewer<float>> viewers,
+           const StreamingSettings<float>& limits) {
+    streamer.update(viewers);
+    const StreamingStats stats = streamer.stats();
+    int failures = 0;
+    if (stats.voxel_bytes + stats.mesh_bytes > limits.memory_budget) {
+        std::cout << stats.voxel_bytes + stats.mesh_bytes << " bytes, over the budget of " << limits.memory_budget
+                  << std::endl;
+        ++failures;
+    }
+    if (stats.completed_last_update > limits.max_completions_per_update) {
+        std::cout << stats.completed_last_update << " completions in one update" << std::endl;
+        ++failures;
+    }
+    return failures;
+}
+
+void move(std::span<StreamingViewer<float>> viewers, float seconds) {
+    for (auto& viewer : viewers) {
+        for (size_t axis = 0; axis < 3; ++axis) {
+            viewer.position[axis] += viewer.velocity[axis] * seconds;
+        }
+    }
+}
+
+int main() {
+
+    constexpr float FRAME_SECONDS = 0.1f;
+    int failures = 0;
+
+    // A budget too tight for all the wanted blocks, which eviction must keep to
+    {
+        const auto limits = settings(size_t(512) << 10);
+        Streamer streamer(field, threshold, limits);
+        StreamingViewer<float> viewers[2] = { { { 0, 0, 0 }, { 30, 0, 0 } }, { { 60, 0, 0 }, { 0, 0, -30 } } };
+        for (size_t frame = 0; frame < 120; ++frame) {
+            move(viewers, FRAME_SECONDS);
+            failures += update(streamer, viewers, limits);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        if (streamer.stats().completed == 0) {
+            std::cout << "tight budget: nothing extracted" << std::endl;
+            ++failures;
+        }
+    }
+
+    // Room for everything: once the viewers stop, every wanted block gets the mesh of its transition sides
+    {
+        const auto limits = settings(size_t(256) << 20);
+        Streamer streamer(field, threshold, limits);
+        StreamingViewer<float> viewers[2] = { { { 0, 0, 0 }, { 20, 5, 0 } }, { { 40, 0, 0 }, { 0, 0, -20 } } };
+        for (size_t frame = 0; frame < 30; ++frame) {
+            move(viewers, FRAME_SECONDS);
+            failures += update(streamer, viewers, limits);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        for (auto& viewer : viewers) {
+            viewer.velocity = { 0, 0, 0 };
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        StreamingStats stats;
+        do {
+            failures += update(streamer, viewers, limits);
+            stats = streamer.stats();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } while ((stats.missing_blocks != 0 || stats.in_flight != 0) && std::chrono::steady_clock::now() < deadline);
+        if (stats.missing_blocks != 0 || stats.in_flight != 0) {
+            std::cout << stats.missing_blocks << " holes and " << stats.in_flight << " extractions left" << std::endl;
+            ++failures;
+        }
+
+        size_t visible = 0;
+        size_t with_sides = 0;
+        streamer.for_each_visible([&](const Block<float>& block, const Mesh<float>& mesh, TransitionSides sides) {
+            ++visible;
+            with_sides += sides.any() ? 1 : 0;
+            if (!same_mesh(mesh, extract_from_field(field, block, threshold, sides))) {
+                std::cout << "block at " << block.dims.base[0] << " " << block.dims.base[1] << " "
+                          << block.dims.base[2] << ", size " << block.dims.size << ", sides " << sides
+                          << ": meshes differ" << std::endl;
+                ++failures;
+            }
+        });
+        if (visible != stats.wanted_blocks || with_sides == 0) {
+            std::cout << visible << " visible blocks, " << with_sides << " with transition sides, of "
+                      << stats.wanted_blocks << " wanted" << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
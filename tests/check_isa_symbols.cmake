@@ -0,0 +1,23 @@
+# Fails when an object built for a wider instruction set holds a weak definition outside the namespace of its
+# lane types: such a definition is shared with the other builds, and the linker keeps any one of the copies.
+# Usage: cmake -DNM=<nm> -DOBJECTS=<object>|<object>... -P check_isa_symbols.cmake
+
+string(REPLACE "|" ";" OBJECTS "${OBJECTS}")
+set(shared_symbols "")
+foreach(object ${OBJECTS})
+    execute_process(COMMAND ${NM} -C ${object} OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${NM} failed on ${object}")
+    endif()
+    string(REPLACE "\n" ";" symbols "${symbols}")
+    foreach(symbol ${symbols})
+        if(symbol MATCHES " [WV] " AND NOT symbol MATCHES "simd_avx(2|512)::")
+            list(APPEND shared_symbols "${object}: ${symbol}")
+        endif()
+    endforeach()
+endforeach()
+
+if(shared_symbols)
+    list(JOIN shared_symbols "\n" shared_symbols)
+    message(FATAL_ERROR "Weak symbols shared across instruction sets:\n${shared_symbols}")
+endif()
@@ -1,16 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <functional>
+#include <optional>
+#include <type_traits>
 
 template <typename F>
 struct Density {
 
-    static bool inside(F value) {
-        return value > 0.0f;
+    static bool inside(F value, F threshold) {
+        return value > threshold;
     }
 
     static std::array<float, 3> to_normal(const F& a, const F& b, const F& c) {
@@ -37,6 +41,82 @@ struct Density {
     static constexpr float shrink_factor() {
         return 0.15f;
     }
+
+    /**
+    Converts a bound computed in floating point to a density. `upward` tells which way to round for the
+    bound to stay conservative
+    */
+    template <typename V>
+    static F bound_from(V value, bool upward) {
+        return static_cast<F>(value);
+    }
+};
+
+/**
+Densities stored in a compact type (small integers, half floats) to shrink caches and voxel stores.
+Interpolation and gradients are computed in float
+*/
+template <typename Q>
+struct CompactDensity {
+
+    static bool inside(Q value, Q threshold) {
+        return value > threshold;
+    }
+
+    static std::array<float, 3> to_normal(float a, float b, float c) {
+        return Density<float>::to_normal(a, b, c);
+    }
+
+    static float interp(Q a, Q b, Q threshold) {
+        const float difference = static_cast<float>(b) - static_cast<float>(a);
+        if (difference != 0.0f) {
+            return (static_cast<float>(threshold) - static_cast<float>(a)) / difference;
+        } else {
+            return 0.5f;
+        }
+    }
+
+    static float diff(Q value, Q other) {
+        return static_cast<float>(value) - static_cast<float>(other);
+    }
+
+    static constexpr float shrink_factor() {
+        return 0.15f;
+    }
+
+    template <typename V>
+    static Q bound_from(V value, bool upward) {
+        if constexpr (std::is_integral_v<Q>) {
+            const V rounded = upward ? std::ceil(value) : std::floor(value);
+            const V lowest = static_cast<V>(std::numeric_limits<Q>::lowest());
+            const V highest = static_cast<V>(std::numeric_limits<Q>::max());
+            return static_cast<Q>(std::clamp(rounded, lowest, highest));
+        } else {
+            // Half floats: conversion rounds to nearest, so widen by one unit in the last place first
+            const V unit = std::abs(value) * static_cast<V>(0x1p-10) + static_cast<V>(0x1p-24);
+            return static_cast<Q>(upward ? value + unit : value - unit);
+        }
+    }
+};
+
+template <>
+struct Density<int8_t> : public CompactDensity<int8_t> {};
+
+template <>
+struct Density<int16_t> : public CompactDensity<int16_t> {};
+
+#if defined(__FLT16_MAX__)
+template <>
+struct Density<_Float16> : public CompactDensity<_Float16> {};
+#endif
+
+/**
+Lowest and highest density over some region
+*/
+template <typename D>
+struct DensityBounds {
+    D min;
+    D max;
 };
 
 template <typename D, typename F>
@@ -45,9 +125,65 @@ struct ScalarField {
     Obtain the density at the given point in space
     */
     virtual D get_density(F x, F y, F z) const = 0;
+
+    /**
+    Obtain the densities at `count` points. Fields able to evaluate several points at once override this
+    */
+    virtual void get_densities(const F* x, const F* y, const F* z, D* densities, size_t count) const {
+        for (size_t i = 0; i < count; ++i) {
+            densities[i] = get_density(x[i], y[i], z[i]);
+        }
+    }
+
+    /**
+    Bounds of the density over the box from `low` to `high`, if the field can tell. They let the extraction
+    skip blocks that cannot contain the surface.
+    By default, derived from the Lipschitz constant and the density at the centre of the box
+    */
+    virtual std::optional<DensityBounds<D>> density_bounds(const std::array<F, 3>& low, const std::array<F, 3>& high) const {
+        const auto lipschitz = lipschitz_constant();
+        if (!lipschitz) {
+            return std::nullopt;
+        }
+        std::array<F, 3> centre;
+        F squared_radius = 0;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            centre[axis] = 0.5f * (low[axis] + high[axis]);
+            const F half_size = 0.5f * (high[axis] - low[axis]);
+            squared_radius += half_size * half_size;
+        }
+        const F value = static_cast<F>(get_density(centre[0], centre[1], centre[2]));
+        const F reach = *lipschitz * std::sqrt(squared_radius);
+        return DensityBounds<D>{ Density<D>::bound_from(value - reach, false), Density<D>::bound_from(value + reach, true) };
+    }
+
+    /**
+    Upper bound of how fast the density changes: |density(p) - density(q)| <= L * |p - q|, if known
+    */
+    virtual std::optional<F> lipschitz_constant() const {
+        return std::nullopt;
+    }
+
+    /**
+    Tells the field it will only be sampled within the box from `low` to `high`, so it can drop whatever
+    does not change the densities there
+    */
+    virtual void restrict_to(const std::array<F, 3>& low, const std::array<F, 3>& high) {}
+
     virtual ~ScalarField() = default;
 };
 
+/**
+Whether `get_density` of a field or voxel source can be called from several threads at once.
+Specialize it with `thread_safe()` returning true to let the density prefetch run in parallel
+*/
+template <typename SF>
+struct FieldThreading {
+    static constexpr bool thread_safe() {
+        return false;
+    }
+};
+
 template <typename D, typename F>
 struct ScalarFieldForFn : public ScalarField<D, F> {
     ScalarFieldForFn(D (*func)(F, F, F)) : m_function(func) {}
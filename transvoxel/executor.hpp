@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+Runs batches of independent work items. Implement it to plug the extraction into an existing job system
+*/
+struct Executor {
+    /**
+    Call `body(i)` once for every `i` in [0, count), in any order and on any thread.
+    Only returns once all the calls are done
+    */
+    virtual void parallel_for(size_t count, const std::function<void(size_t)>& body) const = 0;
+    virtual ~Executor() = default;
+};
+
+/**
+Runs everything on the calling thread
+*/
+struct SerialExecutor : public Executor {
+    void parallel_for(size_t count, const std::function<void(size_t)>& body) const override {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+    }
+};
+
+/**
+Spreads the items over short-lived threads, the calling thread taking its share
+*/
+struct ThreadExecutor : public Executor {
+    ThreadExecutor(size_t threads = std::thread::hardware_concurrency())
+        : threads(std::max<size_t>(threads, 1)) {}
+
+    void parallel_for(size_t count, const std::function<void(size_t)>& body) const override {
+        std::atomic<size_t> next_item(0);
+        auto work = [&]() {
+            for (size_t i = next_item++; i < count; i = next_item++) {
+                body(i);
+            }
+        };
+        std::vector<std::thread> helpers;
+        const size_t num_helpers = std::min(threads, count) - (count > 0 ? 1 : 0);
+        helpers.reserve(num_helpers);
+        for (size_t t = 0; t < num_helpers; ++t) {
+            helpers.emplace_back(work);
+        }
+        work();
+        for (auto& helper : helpers) {
+            helper.join();
+        }
+    }
+
+    size_t threads;
+};
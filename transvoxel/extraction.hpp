@@ -1,23 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
 #include "structs.hpp"
 #include "transition_sides.hpp"
 #include "voxel_source.hpp"
 #include "implementation/extractor.hpp"
 
 template <typename F, typename D, typename S>
-Mesh<F> extract(S source, const Block<F>& block, const D& threshold, TransitionSides transition_sides) {
-    Extractor<F, D, S> extractor(source, block, threshold, transition_sides);
+Mesh<F> extract(S source, const Block<F>& block, const D& threshold, TransitionSides transition_sides,
+                const ExtractionOptions& options = {}) {
+    Extractor<F, D, S> extractor(source, block, threshold, transition_sides, options);
+    return extractor.extract();
+}
+
+/**
+Voxels of `block` sampled from `source` on first use, and kept for other extractions of the block: see
+`PreCachingVoxelSource`. Only the executor and cache layout of `options` matter
+*/
+template <typename D, typename F, typename S>
+std::shared_ptr<PreCachingVoxelSource<D, S>> make_voxel_cache(S source, const Block<F>& block,
+                                                              const ExtractionOptions& options = {}) {
+    return std::make_shared<PreCachingVoxelSource<D, S>>(std::move(source), block.subdivisions, options.executor,
+                                                         options.cache_layout);
+}
+
+/**
+Same as `extract`, from the voxels of `cache`. Extracting again with another threshold or other transition sides
+only samples the transition sides not loaded yet, and with adaptive sampling, the placeholders that are not on one
+side of the new surface
+*/
+template <typename F, typename D, typename S>
+Mesh<F> extract(const std::shared_ptr<PreCachingVoxelSource<D, S>>& cache, const Block<F>& block, const D& threshold,
+                TransitionSides transition_sides, const ExtractionOptions& options = {}) {
+    Extractor<F, D, S> extractor(cache, block, threshold, transition_sides, options);
     return extractor.extract();
 }
 
+/**
+Same as `extract`, but the transition voxels of the sides with an entry in `neighbours` are read from the finer
+blocks there, which have sampled them already, instead of the source
+*/
+template <typename F, typename D, typename S>
+Mesh<F> extract_with_neighbours(S source, const Block<F>& block, const D& threshold, TransitionSides transition_sides,
+                                const std::array<const NeighbourVoxelSource<D>*, 6>& neighbours,
+                                const ExtractionOptions& options = {}) {
+    Extractor<F, D, S> extractor(source, block, threshold, transition_sides, options);
+    extractor.density_source->transition_neighbours = neighbours;
+    return extractor.extract();
+}
+
+/**
+Extracts once for any transition sides: see `LayeredMesh`
+*/
+template <typename F, typename D, typename S>
+LayeredMesh<F> extract_layered(S source, const Block<F>& block, const D& threshold,
+                               const ExtractionOptions& options = {}) {
+    Extractor<F, D, S> extractor(source, block, threshold, no_side(), options);
+    return extractor.extract_layered();
+}
+
+/**
+Extracts the surfaces of several thresholds of the same source, one mesh per threshold in their order. The
+voxels are sampled once for all of them
+*/
+template <typename F, typename D, typename S>
+std::vector<Mesh<F>> extract_multi(S source, const Block<F>& block, std::span<const D> thresholds,
+                                   TransitionSides transition_sides, const ExtractionOptions& options = {}) {
+    Extractor<F, D, S> extractor(source, block, thresholds.empty() ? D{} : thresholds[0], transition_sides, options);
+    return extractor.extract_multi(thresholds);
+}
 
 template <typename F, typename D, typename SF>
 Mesh<F> extract_from_field(
-    SF source, const Block<F>& block, const D& threshold, TransitionSides transition_sides)
+    SF source, const Block<F>& block, const D& threshold, TransitionSides transition_sides,
+    const ExtractionOptions& options = {})
 {
     using WS = WorldMappingVoxelSource<F, D, SF>;
 
     WS new_src{ source, block };
-    return Extractor<F, D, WS>(new_src, block, threshold, transition_sides).extract();
+    return Extractor<F, D, WS>(new_src, block, threshold, transition_sides, options).extract();
 }
 
 template <typename F, typename S, typename C, typename D, typename FUN>
@@ -27,4 +98,130 @@ auto extract_from_fn(FUN f, const Block<F>& block, D threshold, TransitionSides
     auto source = WorldMappingVoxelSource<C, D, decltype(field)>{field, &block};
 
     return Extractor<F, D, decltype(source)>(source, block, threshold, transition_sides).extract();
-}
\ No newline at end of file
+}
+/**
+Lattice coordinates of `blocks`, in block sizes from the first one, if they all have the same size and
+subdivisions, and bases on a common grid
+*/
+template <typename F>
+std::optional<std::vector<std::array<int64_t, 3>>> aligned_block_coordinates(std::span<const Block<F>> blocks) {
+    std::vector<std::array<int64_t, 3>> coordinates;
+    coordinates.reserve(blocks.size());
+    for (const auto& block : blocks) {
+        if (block.dims.size != blocks[0].dims.size || block.subdivisions != blocks[0].subdivisions) {
+            return std::nullopt;
+        }
+        std::array<int64_t, 3> coordinate;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            const double ratio = static_cast<double>(block.dims.base[axis] - blocks[0].dims.base[axis])
+                / static_cast<double>(block.dims.size);
+            const double rounded = std::round(ratio);
+            if (std::abs(ratio - rounded) > 1e-4) {
+                return std::nullopt;
+            }
+            coordinate[axis] = static_cast<int64_t>(rounded);
+        }
+        coordinates.push_back(coordinate);
+    }
+    return coordinates;
+}
+
+/**
+Groups blocks, given by their lattice coordinates, into sets touching each other through faces, edges or
+corners. Each group lists its blocks in increasing order
+*/
+inline std::vector<std::vector<size_t>> touching_block_groups(const std::vector<std::array<int64_t, 3>>& coordinates) {
+    std::map<std::array<int64_t, 3>, size_t> block_at;
+    for (size_t i = 0; i < coordinates.size(); ++i) {
+        block_at.emplace(coordinates[i], i);
+    }
+    std::vector<std::vector<size_t>> groups;
+    std::vector<bool> grouped(coordinates.size(), false);
+    for (size_t first = 0; first < coordinates.size(); ++first) {
+        if (grouped[first]) {
+            continue;
+        }
+        grouped[first] = true;
+        std::vector<size_t> group{ first };
+        for (size_t next = 0; next < group.size(); ++next) {
+            const auto coordinate = coordinates[group[next]];
+            for (int64_t dx = -1; dx <= 1; ++dx) {
+                for (int64_t dy = -1; dy <= 1; ++dy) {
+                    for (int64_t dz = -1; dz <= 1; ++dz) {
+                        auto it = block_at.find({ coordinate[0] + dx, coordinate[1] + dy, coordinate[2] + dz });
+                        if (it != block_at.end() && !grouped[it->second]) {
+                            grouped[it->second] = true;
+                            group.push_back(it->second);
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(group.begin(), group.end());
+        groups.push_back(std::move(group));
+    }
+    return groups;
+}
+
+/**
+Extracts several blocks of a field, sampling the voxels shared by adjacent blocks (faces, and the layers out of
+a block read for gradients) once. Blocks of the same size and subdivisions, on a common grid, are grouped into
+sets touching each other, and each set shares a lattice spanning its bounding box. Sets whose bounding box is much
+larger than their blocks (a diagonal line, say), and blocks not on a common grid, are extracted one by one.
+`transition_sides` is empty or has one entry per block. Meshes come in the order of the blocks
+*/
+template <typename F, typename D, typename SF>
+std::vector<Mesh<F>> extract_many_from_field(
+    const SF& field, std::span<const Block<F>> blocks, const D& threshold,
+    std::span<const TransitionSides> transition_sides = {}, const ExtractionOptions& options = {})
+{
+    // Largest bounding box of a lattice, in blocks per block of its set
+    constexpr size_t MAX_LATTICE_BLOCKS_PER_BLOCK = 4;
+
+    assert(transition_sides.empty() || transition_sides.size() == blocks.size());
+    std::vector<Mesh<F>> meshes(blocks.size());
+    const auto sides_of = [&](size_t i) {
+        return transition_sides.empty() ? no_side() : transition_sides[i];
+    };
+    const auto coordinates = blocks.empty() ? std::nullopt : aligned_block_coordinates(blocks);
+    if (!coordinates) {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            meshes[i] = extract_from_field(field, blocks[i], threshold, sides_of(i), options);
+        }
+        return meshes;
+    }
+
+    const int64_t subs = static_cast<int64_t>(blocks[0].subdivisions);
+    using LS = LatticeVoxelSource<F, D, SF>;
+    for (const auto& group : touching_block_groups(*coordinates)) {
+        std::array<int64_t, 3> low = (*coordinates)[group[0]];
+        std::array<int64_t, 3> high = low;
+        for (size_t i : group) {
+            for (size_t axis = 0; axis < 3; ++axis) {
+                low[axis] = std::min(low[axis], (*coordinates)[i][axis]);
+                high[axis] = std::max(high[axis], (*coordinates)[i][axis]);
+            }
+        }
+        size_t box_blocks = 1;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            box_blocks *= static_cast<size_t>(high[axis] - low[axis] + 1);
+        }
+        if (group.size() == 1 || box_blocks > MAX_LATTICE_BLOCKS_PER_BLOCK * group.size()) {
+            for (size_t i : group) {
+                meshes[i] = extract_from_field(field, blocks[i], threshold, sides_of(i), options);
+            }
+            continue;
+        }
+        for (size_t axis = 0; axis < 3; ++axis) {
+            low[axis] = low[axis] * subs - 1;
+            high[axis] = (high[axis] + 1) * subs + 1;
+        }
+        VoxelLattice<D> lattice(low, high);
+        for (size_t i : group) {
+            const auto& coordinate = (*coordinates)[i];
+            LS source(field, blocks[i], lattice, { coordinate[0] * subs, coordinate[1] * subs, coordinate[2] * subs });
+            meshes[i] = Extractor<F, D, LS>(source, blocks[i], threshold, sides_of(i), options).extract();
+        }
+    }
+    return meshes;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "extraction.hpp"
+
+template <typename F>
+struct ExtractionJobState {
+    uint64_t id;
+    float priority;
+    std::atomic<bool> cancelled;
+    std::function<Mesh<F>(const ExtractionOptions&)> run;
+    std::promise<std::optional<Mesh<F>>> promise;
+
+    ExtractionJobState(uint64_t id, float priority, std::function<Mesh<F>(const ExtractionOptions&)> run)
+        : id(id), priority(priority), cancelled(false), run(std::move(run)), promise() {}
+};
+
+/**
+Handle on a submitted extraction. The result is empty if the job got cancelled
+*/
+template <typename F>
+struct ExtractionJob {
+    std::shared_ptr<ExtractionJobState<F>> state;
+    std::shared_future<std::optional<Mesh<F>>> result;
+};
+
+/**
+Runs extractions on a pool of worker threads, lowest priority value first (the priority is typically the
+distance to the camera). Queued jobs can be cancelled or reprioritized, and running jobs notice a cancellation
+between slices of regular cells
+*/
+template <typename F>
+class ExtractionQueue {
+public:
+    using Result = std::optional<Mesh<F>>;
+
+    ExtractionQueue(size_t num_workers = std::thread::hardware_concurrency(), const ExtractionOptions& options = {})
+        : options(options), next_id(0), stopping(false) {
+        num_workers = std::max<size_t>(num_workers, 1);
+        for (size_t i = 0; i < num_workers; ++i) {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    ExtractionQueue(const ExtractionQueue&) = delete;
+    ExtractionQueue& operator=(const ExtractionQueue&) = delete;
+
+    /**
+    Cancels everything still queued, and waits for the running jobs
+    */
+    ~ExtractionQueue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            for (const auto& [key, state] : queued) {
+                state->cancelled = true;
+                state->promise.set_value(std::nullopt);
+            }
+            queued.clear();
+        }
+        wake_up.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    template <typename D, typename S>
+    ExtractionJob<F> submit(S source, const Block<F>& block, D threshold, TransitionSides transition_sides,
+                            float priority) {
+        return submit_task([source, block, threshold, transition_sides](const ExtractionOptions& job_options) {
+            return extract(source, block, threshold, transition_sides, job_options);
+        }, priority);
+    }
+
+    /**
+    Queues an arbitrary extraction. `task` must forward the options it receives, so it can be cancelled
+    */
+    ExtractionJob<F> submit_task(std::function<Mesh<F>(const ExtractionOptions&)> task, float priority) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto state = std::make_shared<ExtractionJobState<F>>(next_id++, priority, std::move(task));
+        ExtractionJob<F> job{ state, state->promise.get_future().share() };
+        queued.emplace(std::make_pair(priority, state->id), state);
+        wake_up.notify_one();
+        return job;
+    }
+
+    /**
+    A queued job is dropped right away. A running one stops at its next cancellation point
+    */
+    void cancel(const ExtractionJob<F>& job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        job.state->cancelled = true;
+        auto it = queued.find(std::make_pair(job.state->priority, job.state->id));
+        if (it != queued.end()) {
+            queued.erase(it);
+            job.state->promise.set_value(std::nullopt);
+        }
+    }
+
+    /**
+    Returns false if the job is not queued anymore (running, done or cancelled)
+    */
+    bool reprioritize(const ExtractionJob<F>& job, float priority) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = queued.find(std::make_pair(job.state->priority, job.state->id));
+        if (it == queued.end()) {
+            return false;
+        }
+        queued.erase(it);
+        job.state->priority = priority;
+        queued.emplace(std::make_pair(priority, job.state->id), job.state);
+        return true;
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued.size();
+    }
+
+private:
+    using QueueKey = std::pair<float, uint64_t>; // (priority, submission order)
+
+    void work() {
+        while (true) {
+            std::shared_ptr<ExtractionJobState<F>> state;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake_up.wait(lock, [this]() { return stopping || !queued.empty(); });
+                if (queued.empty()) {
+                    return;
+                }
+                state = queued.begin()->second;
+                queued.erase(queued.begin());
+            }
+            ExtractionOptions job_options = options;
+            job_options.cancelled = &state->cancelled;
+            try {
+                Mesh<F> mesh = state->run(job_options);
+                if (state->cancelled) {
+                    state->promise.set_value(std::nullopt);
+                } else {
+                    state->promise.set_value(std::move(mesh));
+                }
+            } catch (...) {
+                state->promise.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    ExtractionOptions options;
+    mutable std::mutex mutex;
+    std::condition_variable wake_up;
+    std::map<QueueKey, std::shared_ptr<ExtractionJobState<F>>> queued;
+    std::vector<std::thread> workers;
+    uint64_t next_id;
+    bool stopping;
+};
@@ -27,22 +27,6 @@ std::array<Rotation, 6> ROTATIONS = {
         {1, 0, 1}, {-1, 0, 0}, {0, 1, 0}, {0, 0, -1}},
 };
 
-std::array<TransitionCellGridPoint, 13> TRANSITION_CELL_GRID_POINTS = {
-    tcell_highres_face_gridpoint(0, 0),
-    tcell_highres_face_gridpoint(1, 0),
-    tcell_highres_face_gridpoint(2, 0),
-    tcell_highres_face_gridpoint(0, 1),
-    tcell_highres_face_gridpoint(1, 1),
-    tcell_highres_face_gridpoint(2, 1),
-    tcell_highres_face_gridpoint(0, 2),
-    tcell_highres_face_gridpoint(1, 2),
-    tcell_highres_face_gridpoint(2, 2),
-    tcell_reg_face_gridpoint(0, 0),
-    tcell_reg_face_gridpoint(1, 0),
-    tcell_reg_face_gridpoint(0, 1),
-    tcell_reg_face_gridpoint(1, 1)
-};
-
 std::array<std::pair<HighResolutionVoxelDelta, size_t>, 9> TRANSITION_HIGH_RES_FACE_CASE_CONTRIBUTIONS = {
     std::pair<HighResolutionVoxelDelta, size_t>{ HighResolutionVoxelDelta({0, 0, 0}), 0x01 },
     std::pair<HighResolutionVoxelDelta, size_t>{ HighResolutionVoxelDelta({1, 0, 0}), 0x02 },
@@ -25,42 +25,4 @@ inline RegularVoxelDelta get_regular_voxel_delta(const RegularCellVoxelIndex& in
     return REGULAR_CELL_VOXELS[index.index];
 }
 
-struct TransitionCellGridPointIndex {
-    size_t index;
-};
-
-enum class TransitionCellGridPointType {
-    HighResFace,
-    RegularFace
-};
-
-struct TransitionCellGridPoint {
-    TransitionCellGridPointType type;
-    union {
-        HighResolutionVoxelDelta highResFace;
-        struct {
-            size_t u, v;
-        } regularFace;
-    } data;
-
-    TransitionCellGridPoint(TransitionCellGridPointType type, HighResolutionVoxelDelta highResFace) : type(type) {
-        data.highResFace = highResFace;
-    }
-
-    TransitionCellGridPoint(TransitionCellGridPointType type, size_t u, size_t v) : type(type) {
-        data.regularFace.u = u;
-        data.regularFace.v = v;
-    }
-};
-
-inline TransitionCellGridPoint tcell_highres_face_gridpoint(int64_t u, int64_t v) {
-    return TransitionCellGridPoint(TransitionCellGridPointType::HighResFace, HighResolutionVoxelDelta({u, v, 0}));
-}
-
-inline TransitionCellGridPoint tcell_reg_face_gridpoint(size_t u, size_t v) {
-    return TransitionCellGridPoint(TransitionCellGridPointType::RegularFace, u, v);
-}
-
-extern std::array<TransitionCellGridPoint, 13> TRANSITION_CELL_GRID_POINTS;
-
 extern std::array<std::pair<HighResolutionVoxelDelta, size_t>, 9> TRANSITION_HIGH_RES_FACE_CASE_CONTRIBUTIONS;
\ No newline at end of file
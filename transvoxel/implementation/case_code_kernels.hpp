@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+// The kernels of `case_codes.hpp`, for the instruction sets enabled in the including translation unit. Built once
+// per instruction set with runtime dispatch (see `cpu_dispatch.hpp`), in the namespace of its lanes.
+
+inline namespace TRANSVOXEL_SIMD_NAMESPACE {
+
+inline void classify_densities_scalar(const float* densities, size_t count, float level, uint8_t* inside) {
+    for (size_t i = 0; i < count; ++i) {
+        inside[i] = densities[i] > level ? 1 : 0;
+    }
+}
+
+inline uint8_t case_code_scalar(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                                const uint8_t* row_11, size_t z) {
+    return static_cast<uint8_t>(row_00[z] | (row_10[z] << 1) | (row_01[z] << 2) | (row_11[z] << 3)
+        | (row_00[z + 1] << 4) | (row_10[z + 1] << 5) | (row_01[z + 1] << 6) | (row_11[z + 1] << 7));
+}
+
+#if defined(__SSE2__)
+/// 16 flags from 16 densities: the comparison masks are narrowed to bytes with saturating packs, which keep order
+inline __m128i inside_flags_sse2(const float* densities, __m128 level) {
+    const __m128i m0 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(densities), level));
+    const __m128i m1 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(densities + 4), level));
+    const __m128i m2 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(densities + 8), level));
+    const __m128i m3 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(densities + 12), level));
+    const __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+    return _mm_and_si128(bytes, _mm_set1_epi8(1));
+}
+
+/// Flags are 0 or 1, so shifting 16-bit lanes never carries into the next byte
+inline __m128i case_codes_sse2(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                               const uint8_t* row_11) {
+    const auto load = [](const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+    __m128i codes = load(row_00);
+    codes = _mm_or_si128(codes, _mm_slli_epi16(load(row_10), 1));
+    codes = _mm_or_si128(codes, _mm_slli_epi16(load(row_01), 2));
+    codes = _mm_or_si128(codes, _mm_slli_epi16(load(row_11), 3));
+    codes = _mm_or_si128(codes, _mm_slli_epi16(load(row_00 + 1), 4));
+    codes = _mm_or_si128(codes, _mm_slli_epi16(load(row_10 + 1), 5));
+    codes = _mm_or_si128(codes, _mm_slli_epi16(load(row_01 + 1), 6));
+    return _mm_or_si128(codes, _mm_slli_epi16(load(row_11 + 1), 7));
+}
+#endif
+
+#if defined(__AVX2__)
+/// 32 flags from 32 densities. The packs work within 128-bit halves, hence the final permutation
+inline __m256i inside_flags_avx2(const float* densities, __m256 level) {
+    const __m256i m0 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(densities), level, _CMP_GT_OQ));
+    const __m256i m1 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(densities + 8), level, _CMP_GT_OQ));
+    const __m256i m2 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(densities + 16), level, _CMP_GT_OQ));
+    const __m256i m3 = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(densities + 24), level, _CMP_GT_OQ));
+    const __m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(m0, m1), _mm256_packs_epi32(m2, m3));
+    const __m256i ordered = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    return _mm256_and_si256(ordered, _mm256_set1_epi8(1));
+}
+
+inline __m256i case_codes_avx2(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                               const uint8_t* row_11) {
+    const auto load = [](const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); };
+    __m256i codes = load(row_00);
+    codes = _mm256_or_si256(codes, _mm256_slli_epi16(load(row_10), 1));
+    codes = _mm256_or_si256(codes, _mm256_slli_epi16(load(row_01), 2));
+    codes = _mm256_or_si256(codes, _mm256_slli_epi16(load(row_11), 3));
+    codes = _mm256_or_si256(codes, _mm256_slli_epi16(load(row_00 + 1), 4));
+    codes = _mm256_or_si256(codes, _mm256_slli_epi16(load(row_10 + 1), 5));
+    codes = _mm256_or_si256(codes, _mm256_slli_epi16(load(row_01 + 1), 6));
+    return _mm256_or_si256(codes, _mm256_slli_epi16(load(row_11 + 1), 7));
+}
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+/// 64 flags from 64 densities, straight from the comparison masks
+inline __m512i inside_flags_avx512(const float* densities, __m512 level) {
+    const uint64_t m0 = _mm512_cmp_ps_mask(_mm512_loadu_ps(densities), level, _CMP_GT_OQ);
+    const uint64_t m1 = _mm512_cmp_ps_mask(_mm512_loadu_ps(densities + 16), level, _CMP_GT_OQ);
+    const uint64_t m2 = _mm512_cmp_ps_mask(_mm512_loadu_ps(densities + 32), level, _CMP_GT_OQ);
+    const uint64_t m3 = _mm512_cmp_ps_mask(_mm512_loadu_ps(densities + 48), level, _CMP_GT_OQ);
+    return _mm512_maskz_set1_epi8(m0 | (m1 << 16) | (m2 << 32) | (m3 << 48), 1);
+}
+
+inline __m512i case_codes_avx512(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                                 const uint8_t* row_11) {
+    const auto load = [](const uint8_t* p) { return _mm512_loadu_si512(p); };
+    __m512i codes = load(row_00);
+    codes = _mm512_or_si512(codes, _mm512_slli_epi16(load(row_10), 1));
+    codes = _mm512_or_si512(codes, _mm512_slli_epi16(load(row_01), 2));
+    codes = _mm512_or_si512(codes, _mm512_slli_epi16(load(row_11), 3));
+    codes = _mm512_or_si512(codes, _mm512_slli_epi16(load(row_00 + 1), 4));
+    codes = _mm512_or_si512(codes, _mm512_slli_epi16(load(row_10 + 1), 5));
+    codes = _mm512_or_si512(codes, _mm512_slli_epi16(load(row_01 + 1), 6));
+    return _mm512_or_si512(codes, _mm512_slli_epi16(load(row_11 + 1), 7));
+}
+#endif
+
+inline void classify_densities_kernel(const float* densities, size_t count, float level, uint8_t* inside) {
+    size_t i = 0;
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    const __m512 level_512 = _mm512_set1_ps(level);
+    for (; i + 64 <= count; i += 64) {
+        _mm512_storeu_si512(inside + i, inside_flags_avx512(densities + i, level_512));
+    }
+#endif
+#if defined(__AVX2__)
+    const __m256 level_256 = _mm256_set1_ps(level);
+    for (; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(inside + i), inside_flags_avx2(densities + i, level_256));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128 level_128 = _mm_set1_ps(level);
+    for (; i + 16 <= count; i += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(inside + i), inside_flags_sse2(densities + i, level_128));
+    }
+#endif
+    classify_densities_scalar(densities + i, count - i, level, inside + i);
+}
+
+inline void combine_case_codes_kernel(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                                     const uint8_t* row_11, size_t cells, uint8_t* codes) {
+    // Vector loads read up to the flag of voxel z + width, so they stop one register before the row ends
+    size_t z = 0;
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    for (; z + 64 < cells + 1; z += 64) {
+        _mm512_storeu_si512(codes + z, case_codes_avx512(row_00 + z, row_10 + z, row_01 + z, row_11 + z));
+    }
+#endif
+#if defined(__AVX2__)
+    for (; z + 32 < cells + 1; z += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + z),
+                            case_codes_avx2(row_00 + z, row_10 + z, row_01 + z, row_11 + z));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; z + 16 < cells + 1; z += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + z),
+                         case_codes_sse2(row_00 + z, row_10 + z, row_01 + z, row_11 + z));
+    }
+#endif
+    for (; z < cells; ++z) {
+        codes[z] = case_code_scalar(row_00, row_10, row_01, row_11, z);
+    }
+}
+
+}
+
+/// Builds of the kernels for the wider instruction sets, each in its own translation unit
+void classify_densities_avx2(const float* densities, size_t count, float level, uint8_t* inside);
+void combine_case_codes_avx2(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                             const uint8_t* row_11, size_t cells, uint8_t* codes);
+void classify_densities_avx512(const float* densities, size_t count, float level, uint8_t* inside);
+void combine_case_codes_avx512(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                               const uint8_t* row_11, size_t cells, uint8_t* codes);
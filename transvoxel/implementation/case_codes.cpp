@@ -0,0 +1,24 @@
+#include "case_codes.hpp"
+#include "case_code_kernels.hpp"
+#include "cpu_dispatch.hpp"
+
+void classify_densities(const float* densities, size_t count, float level, uint8_t* inside) {
+#if defined(TRANSVOXEL_RUNTIME_DISPATCH)
+    static const auto kernel = select_kernel(&classify_densities_kernel, &classify_densities_avx2,
+                                             &classify_densities_avx512);
+    kernel(densities, count, level, inside);
+#else
+    classify_densities_kernel(densities, count, level, inside);
+#endif
+}
+
+void combine_case_codes(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01, const uint8_t* row_11,
+                        size_t cells, uint8_t* codes) {
+#if defined(TRANSVOXEL_RUNTIME_DISPATCH)
+    static const auto kernel = select_kernel(&combine_case_codes_kernel, &combine_case_codes_avx2,
+                                             &combine_case_codes_avx512);
+    kernel(row_00, row_10, row_01, row_11, cells, codes);
+#else
+    combine_case_codes_kernel(row_00, row_10, row_01, row_11, cells, codes);
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../density.hpp"
+
+// Regular cell case codes computed a row of cells at a time, from the densities of the regular cache, instead of
+// eight density reads per cell.
+
+/**
+Sets `inside[i]` to 1 where `densities[i]` is above `level`, to 0 elsewhere. Uses the widest instruction set
+available
+*/
+void classify_densities(const float* densities, size_t count, float level, uint8_t* inside);
+
+/**
+Other density types, one voxel at a time
+*/
+template <typename D>
+void classify_densities(const D* densities, size_t count, D level, uint8_t* inside) {
+    for (size_t i = 0; i < count; ++i) {
+        inside[i] = Density<D>::inside(densities[i], level) ? 1 : 0;
+    }
+}
+
+/**
+Case codes of `cells` cells along Z, from the inside flags of the four voxel rows at their corners: at the cell
+X and Y, at X + 1, at Y + 1, and at both. Each row has `cells` + 1 flags. The bits follow `REGULAR_CELL_VOXELS`
+*/
+void combine_case_codes(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01, const uint8_t* row_11,
+                        size_t cells, uint8_t* codes);
@@ -0,0 +1,14 @@
+#include "case_code_kernels.hpp"
+
+#if !(defined(__AVX2__))
+#error "Build with -mavx2"
+#endif
+
+void classify_densities_avx2(const float* densities, size_t count, float level, uint8_t* inside) {
+    classify_densities_kernel(densities, count, level, inside);
+}
+
+void combine_case_codes_avx2(const uint8_t* row_00, const uint8_t* row_10, const uint8_t* row_01,
+                             const uint8_t* row_11, size_t cells, uint8_t* codes) {
+    combine_case_codes_kernel(row_00, row_10, row_01, row_11, cells, codes);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "transvoxel.h"
+
+// The Transvoxel tables of transvoxel.h, decoded at compile time into one entry per case code, so that a cell
+// reads a single cache line and no bit fields.
+
+/**
+What the extraction of a regular cell needs, for one case code
+*/
+struct alignas(64) RegularCase {
+    uint8_t vertex_count;
+    uint8_t triangle_count;
+    /// Per vertex, the cell voxels (see `REGULAR_CELL_VOXELS`) at the ends of its edge
+    uint8_t voxel_a[12];
+    uint8_t voxel_b[12];
+    /// Per vertex, 4 * reuse directions (1 for -X, 2 for -Y, 4 for -Z) + reuse index. Without any direction,
+    /// the vertex is new, and stored at its reuse index for the next cells
+    uint8_t reuse_slot[12];
+    /// Vertex indices in the cell, by 3
+    uint8_t triangles[15];
+};
+
+static_assert(sizeof(RegularCase) == 64);
+
+constexpr size_t REGULAR_REUSE_SLOTS = 32;
+
+constexpr std::array<RegularCase, 256> make_regular_cases() {
+    std::array<RegularCase, 256> cases{};
+    for (size_t case_code = 0; case_code < 256; ++case_code) {
+        const RegularCellData& data = regularCellData[regularCellClass[case_code]];
+        RegularCase& entry = cases[case_code];
+        entry.vertex_count = static_cast<uint8_t>(data.geometryCounts >> 4);
+        entry.triangle_count = static_cast<uint8_t>(data.geometryCounts & 0x0F);
+        for (size_t i = 0; i < entry.vertex_count; ++i) {
+            const unsigned short vertex = regularVertexData[case_code][i];
+            const uint8_t reuse_info = static_cast<uint8_t>(vertex >> 8);
+            const uint8_t directions = (reuse_info >> 4) & 0x07;
+            entry.voxel_a[i] = static_cast<uint8_t>((vertex >> 4) & 0x0F);
+            entry.voxel_b[i] = static_cast<uint8_t>(vertex & 0x0F);
+            entry.reuse_slot[i] = static_cast<uint8_t>(4 * directions + (reuse_info & 0x0F));
+        }
+        for (size_t i = 0; i < 3 * static_cast<size_t>(entry.triangle_count); ++i) {
+            entry.triangles[i] = data.vertexIndex[i];
+        }
+    }
+    return cases;
+}
+
+constexpr bool regular_reuse_is_consistent() {
+    // The table only flags vertices as new when they have no reuse direction, and its reuse indices fit in 2 bits
+    for (size_t case_code = 0; case_code < 256; ++case_code) {
+        const long vertex_count = regularCellData[regularCellClass[case_code]].geometryCounts >> 4;
+        for (long i = 0; i < vertex_count; ++i) {
+            const uint8_t reuse_info = static_cast<uint8_t>(regularVertexData[case_code][i] >> 8);
+            const bool is_new = (reuse_info & 0x80) != 0;
+            const bool has_direction = (reuse_info & 0x70) != 0;
+            if (is_new == has_direction || (reuse_info & 0x0F) > 3) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(regular_reuse_is_consistent());
+
+inline constexpr std::array<RegularCase, 256> REGULAR_CASES = make_regular_cases();
+
+/**
+Where the 13 grid points of a transition cell are (Figure 4.16 of the dissertation): the 9 voxels of the high
+resolution face, then the 4 regular voxels of the low resolution face. U and V are in half cells
+*/
+struct TransitionGridPointLocation {
+    bool low_resolution_face;
+    uint8_t u;
+    uint8_t v;
+};
+
+constexpr std::array<TransitionGridPointLocation, 13> TRANSITION_GRID_POINT_LOCATIONS = {{
+    { false, 0, 0 }, { false, 1, 0 }, { false, 2, 0 },
+    { false, 0, 1 }, { false, 1, 1 }, { false, 2, 1 },
+    { false, 0, 2 }, { false, 1, 2 }, { false, 2, 2 },
+    { true, 0, 0 }, { true, 2, 0 }, { true, 0, 2 }, { true, 2, 2 },
+}};
+
+/// Ends of a vertex edge, in `TransitionCase::low_resolution_ends`
+constexpr uint8_t TRANSITION_END_A_LOW_RESOLUTION = 1;
+constexpr uint8_t TRANSITION_END_B_LOW_RESOLUTION = 2;
+/// `TransitionCase::reuse_index` of new vertices that no other cell reuses
+constexpr uint8_t TRANSITION_NOT_REUSED = 0xFF;
+
+/**
+What the extraction of a transition cell needs, for one case code
+*/
+struct alignas(64) TransitionCase {
+    uint8_t vertex_count;
+    uint8_t triangle_count;
+    /// Per vertex, the grid points at the ends of its edge, in half cells
+    uint8_t a_u[12];
+    uint8_t a_v[12];
+    uint8_t b_u[12];
+    uint8_t b_v[12];
+    /// Per vertex, which ends are regular voxels of the low resolution face
+    uint8_t low_resolution_ends[12];
+    /// Per vertex, reuse directions (1 for -U, 2 for -V). Without any, the vertex is new
+    uint8_t reuse_directions[12];
+    /// Per vertex, the reuse index to read it from, or to store it at if it is new and reusable
+    uint8_t reuse_index[12];
+    /// Vertex indices in the cell, by 3, in the winding of the output mesh
+    uint8_t triangles[36];
+};
+
+static_assert(sizeof(TransitionCase) == 128);
+
+constexpr std::array<TransitionCase, 512> make_transition_cases() {
+    std::array<TransitionCase, 512> cases{};
+    for (size_t case_code = 0; case_code < 512; ++case_code) {
+        const unsigned char raw_class = transitionCellClass[case_code];
+        const TransitionCellData& data = transitionCellData[raw_class & 0x7F];
+        TransitionCase& entry = cases[case_code];
+        entry.vertex_count = static_cast<uint8_t>(data.geometryCounts >> 4);
+        entry.triangle_count = static_cast<uint8_t>(data.geometryCounts & 0x0F);
+        for (size_t i = 0; i < entry.vertex_count; ++i) {
+            const unsigned short vertex = transitionVertexData[case_code][i];
+            const uint8_t reuse_info = static_cast<uint8_t>(vertex >> 8);
+            const auto& a = TRANSITION_GRID_POINT_LOCATIONS[(vertex >> 4) & 0x0F];
+            const auto& b = TRANSITION_GRID_POINT_LOCATIONS[vertex & 0x0F];
+            entry.a_u[i] = a.u;
+            entry.a_v[i] = a.v;
+            entry.b_u[i] = b.u;
+            entry.b_v[i] = b.v;
+            entry.low_resolution_ends[i] = static_cast<uint8_t>(
+                (a.low_resolution_face ? TRANSITION_END_A_LOW_RESOLUTION : 0)
+                | (b.low_resolution_face ? TRANSITION_END_B_LOW_RESOLUTION : 0));
+            entry.reuse_directions[i] = static_cast<uint8_t>((reuse_info >> 4) & 0x03);
+            const bool stored = entry.reuse_directions[i] != 0 || (reuse_info & 0x80) != 0;
+            entry.reuse_index[i] = stored ? static_cast<uint8_t>(reuse_info & 0x0F) : TRANSITION_NOT_REUSED;
+        }
+        // The tables wind triangles for the LowZ side as the base case, the same as our outputs, except when the
+        // class has its inversion bit: those are reversed. Rotations to the other sides keep the handedness, so
+        // this is per case only
+        const bool reverse = (raw_class & 0x80) != 0;
+        for (size_t t = 0; t < entry.triangle_count; ++t) {
+            for (size_t corner = 0; corner < 3; ++corner) {
+                entry.triangles[3 * t + corner] = data.vertexIndex[3 * t + (reverse ? 2 - corner : corner)];
+            }
+        }
+    }
+    return cases;
+}
+
+constexpr bool transition_reuse_is_consistent() {
+    // A vertex either comes from a previous cell, or is new, inside the cell or reusable by the next ones
+    for (size_t case_code = 0; case_code < 512; ++case_code) {
+        const long vertex_count = transitionCellData[transitionCellClass[case_code] & 0x7F].geometryCounts >> 4;
+        for (long i = 0; i < vertex_count; ++i) {
+            const uint8_t reuse_info = static_cast<uint8_t>(transitionVertexData[case_code][i] >> 8);
+            const int kinds = ((reuse_info & 0x30) != 0 ? 1 : 0) + ((reuse_info & 0x40) != 0 ? 1 : 0)
+                + ((reuse_info & 0x80) != 0 ? 1 : 0);
+            if (kinds != 1 || (reuse_info & 0x0F) >= 10) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(transition_reuse_is_consistent());
+
+inline constexpr std::array<TransitionCase, 512> TRANSITION_CASES = make_transition_cases();
@@ -0,0 +1,42 @@
+#include "cpu_dispatch.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+SimdLevel supported_simd_level() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    // Also checks that the operating system saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::Avx2;
+    }
+#endif
+    return SimdLevel::Baseline;
+}
+
+SimdLevel requested_simd_level() {
+    const char* requested = std::getenv("TRANSVOXEL_SIMD");
+    if (requested == nullptr || std::strcmp(requested, "avx512") == 0) {
+        return SimdLevel::Avx512;
+    }
+    if (std::strcmp(requested, "avx2") == 0) {
+        return SimdLevel::Avx2;
+    }
+    return SimdLevel::Baseline;
+}
+
+}
+
+SimdLevel detected_simd_level() {
+    static const SimdLevel level = [] {
+        const SimdLevel supported = supported_simd_level();
+        const SimdLevel requested = requested_simd_level();
+        return requested < supported ? requested : supported;
+    }();
+    return level;
+}
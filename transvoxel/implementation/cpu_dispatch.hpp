@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+// Runtime choice between builds of the SIMD kernels for several instruction sets. With
+// TRANSVOXEL_RUNTIME_DISPATCH (set by the CMake build on x86-64), each kernel also has `_avx2` and `_avx512`
+// translation units compiled with those instruction sets, and its entry point calls the widest one the CPU
+// runs. Without it, kernels are only built for the instruction set of the whole build.
+
+enum class SimdLevel : uint8_t {
+    /// What the library as a whole is compiled for: SSE2 on x86-64
+    Baseline,
+    Avx2,
+    /// AVX-512 F and BW
+    Avx512
+};
+
+/**
+The widest level both the CPU and the operating system support, detected on first call. The `TRANSVOXEL_SIMD`
+environment variable (`baseline`, `avx2` or `avx512`) can lower it, to compare variants or work around one
+*/
+SimdLevel detected_simd_level();
+
+/**
+The variant of a kernel for `detected_simd_level()`, or the next narrower one built. Meant to initialize a static
+in the kernel entry point, so that the choice is made once
+*/
+template <typename Fn>
+Fn select_kernel(Fn baseline, Fn avx2, Fn avx512) {
+    const SimdLevel level = detected_simd_level();
+    if (avx512 != nullptr && level >= SimdLevel::Avx512) {
+        return avx512;
+    }
+    if (avx2 != nullptr && level >= SimdLevel::Avx2) {
+        return avx2;
+    }
+    return baseline;
+}
@@ -1,228 +1,513 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <optional>
 #include <vector>
-#include <unordered_map>
+#include "../density.hpp"
+#include "../executor.hpp"
+#include "../voxel_source.hpp"
 #include "../voxel_coordinates.hpp"
 
+/**
+The voxels an extraction reads, sampled from `S` on first use. It can outlive an extraction, to extract again
+with other thresholds or transition sides without sampling anything (see `make_voxel_cache`), and be shared by
+extractions running on several threads: loads are serialized, and never touch what previous loads filled. The
+exception is the placeholders of adaptive sampling, which a later load samples in place: extractions sharing a
+cache read it under `placeholders_mutex`, which that load takes exclusively (see `samples_placeholders`)
+*/
 template<typename D, typename S>
 struct PreCachingVoxelSource {
 
     S inner_source;
     size_t block_subdivisions;
+    DensityCacheLayout cache_layout;
+    // The block voxels and the faces of the layer out of it, in one array ordered by `regular_cache_index`.
+    // The edges and corners of that layer are never read
     std::vector<D> regular_cache;
-    std::vector<D> regular_cache_extended;
-    bool regular_cache_extended_loaded;
-    std::vector<D> transition_cache;
-    bool transition_cache_loaded;
-    std::unordered_map<size_t, size_t> transition_cache_slices; // side -> slice in the cache
+    bool regular_cache_loaded;
+    // Checked for every cell with vertices, so without taking `load_mutex` once set
+    std::atomic<bool> regular_cache_extended_loaded;
+    // After an adaptive load, per tile, whether its voxels are placeholders, and the thresholds they are on one side
+    // of. Empty when all the block voxels are sampled
+    std::vector<uint8_t> placeholder_tiles;
+    size_t placeholder_tile_size;
+    D placeholder_lowest_threshold;
+    D placeholder_highest_threshold;
+    // Per side, once loaded, the voxels of its high resolution face and the ones its gradients read around it: the
+    // layers one step in and out of the block, and the rows one step out of the face. See `transition_cache_index`
+    std::array<std::vector<D>, 6> transition_cache;
+    TransitionSides transition_cache_loaded;
+    mutable std::mutex load_mutex;
+    // Held shared by the extractions reading a shared cache, and exclusively to sample its placeholders
+    std::shared_mutex placeholders_mutex;
+    const Executor* executor; // null, or used to sample in parallel when the source is thread safe
+    // Per side, null or the finer blocks whose samples fill the transition cache instead of the source
+    std::array<const NeighbourVoxelSource<D>*, 6> transition_neighbours;
 
-    PreCachingVoxelSource(S source, size_t block_subdivisions)
+    /// Voxels per side of the tiles of `DensityCacheLayout::Tiled`
+    static constexpr size_t CACHE_TILE_SIZE = 4;
+
+    PreCachingVoxelSource(S source, size_t block_subdivisions, const Executor* executor = nullptr,
+                          DensityCacheLayout cache_layout = DensityCacheLayout::Linear)
     : inner_source(std::move(source)),
       block_subdivisions(block_subdivisions),
+      cache_layout(cache_layout),
       regular_cache(),
-      regular_cache_extended(),
+      regular_cache_loaded(false),
       regular_cache_extended_loaded(false),
+      placeholder_tiles(),
+      placeholder_tile_size(0),
+      placeholder_lowest_threshold(),
+      placeholder_highest_threshold(),
       transition_cache(),
-      transition_cache_loaded(false),
-      transition_cache_slices() 
-    {
-        load_regular_block_voxels();
+      transition_cache_loaded(),
+      load_mutex(),
+      placeholders_mutex(),
+      executor(executor),
+      transition_neighbours()
+    {}
+
+    /**
+    Runs `body` for every item in [0, count), on the executor if the source allows concurrent calls.
+    Items must write to disjoint parts of the caches
+    */
+    template <typename Body>
+    void for_each_item(size_t count, const Body& body) {
+        if (executor != nullptr && FieldThreading<S>::thread_safe()) {
+            executor->parallel_for(count, body);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                body(i);
+            }
+        }
+    }
+
+    /**
+    Bounds of the densities of the voxels from `low` to `high` included, if the source can tell
+    */
+    std::optional<DensityBounds<D>> region_density_bounds(const RegularVoxelIndex& low,
+                                                          const RegularVoxelIndex& high) const {
+        if constexpr (requires { inner_source.region_density_bounds(low, high); }) {
+            return inner_source.region_density_bounds(low, high);
+        } else {
+            return std::nullopt;
+        }
     }
 
     void load_regular_block_voxels() {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        if (regular_cache_loaded && placeholder_tiles.empty()) {
+            return;
+        }
+        if (regular_cache_loaded) {
+            // Only the placeholders are left to sample
+            const size_t tiles = placeholder_tiles_per_side();
+            for_each_item(tiles * tiles * tiles, [&](size_t item) {
+                if (placeholder_tiles[item] != 0) {
+                    load_tile(item, nullptr);
+                }
+            });
+            placeholder_tiles.clear();
+            return;
+        }
+        regular_cache_loaded = true;
         const size_t subs = block_subdivisions;
-        regular_cache.resize((subs + 1) * (subs + 1) * (subs + 1));
-        for (size_t x = 0; x <= subs; ++x) {
+        allocate_regular_cache();
+        // One item per x slice
+        for_each_item(subs + 1, [&](size_t x) {
+            std::vector<D> row;
             for (size_t y = 0; y <= subs; ++y) {
-                for (size_t z = 0; z <= subs; ++z) {
-                    const size_t index = regular_block_index(x, y, z);
-                    regular_cache[index] = from_source(x, y, z);
-                }
+                load_cache_row(x, y, 0, subs + 1, row);
+            }
+        });
+    }
+
+    /**
+    Same as `load_regular_block_voxels`, but tile by tile: a tile is only sampled if the source bounds cannot put
+    it, grown by two voxels, on one side of the surfaces of all the thresholds from `lowest_threshold` to
+    `highest_threshold`. Otherwise its voxels get a placeholder density on that side. All the cells touching a
+    placeholder are then empty, and so are the ones whose vertices have gradients reading it, so the placeholders
+    never end up in the meshes
+    */
+    void load_regular_block_voxels_adaptive(size_t tile_size, const D& lowest_threshold, const D& highest_threshold) {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        if (regular_cache_loaded && placeholder_tiles.empty()) {
+            return;
+        }
+        D lowest = lowest_threshold;
+        D highest = highest_threshold;
+        if (regular_cache_loaded) {
+            if (!(lowest < placeholder_lowest_threshold) && !(placeholder_highest_threshold < highest)) {
+                return;
+            }
+            // Sample the placeholders that are not on one side of the surfaces of the wider range
+            lowest = std::min(lowest, placeholder_lowest_threshold);
+            highest = std::max(highest, placeholder_highest_threshold);
+        } else {
+            regular_cache_loaded = true;
+            allocate_regular_cache();
+            placeholder_tile_size = tile_size;
+            const size_t tiles = placeholder_tiles_per_side();
+            placeholder_tiles.assign(tiles * tiles * tiles, 1);
+        }
+        placeholder_lowest_threshold = lowest;
+        placeholder_highest_threshold = highest;
+        const size_t tiles = placeholder_tiles_per_side();
+        std::atomic<bool> any_placeholder(false);
+        for_each_item(tiles * tiles * tiles, [&](size_t item) {
+            if (placeholder_tiles[item] == 0) {
+                return;
+            }
+            const std::array<D, 2> thresholds = { lowest, highest };
+            placeholder_tiles[item] = load_tile(item, &thresholds) ? 1 : 0;
+            if (placeholder_tiles[item] != 0) {
+                any_placeholder.store(true, std::memory_order_relaxed);
             }
+        });
+        if (!any_placeholder.load()) {
+            placeholder_tiles.clear();
         }
     }
 
-    size_t regular_block_index(int64_t x, int64_t y, int64_t z) const {
-        const size_t subs = block_subdivisions;
-        return (subs + 1) * (subs + 1) * x + (subs + 1) * y + z;
+    /**
+    Whether loading the block voxels would sample placeholders: for the thresholds from `(*thresholds)[0]` to
+    `(*thresholds)[1]` with adaptive sampling, or for all thresholds when `thresholds` is null
+    */
+    bool samples_placeholders(const std::array<D, 2>* thresholds) {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        return regular_cache_loaded && placeholders_in_the_way(thresholds);
     }
 
-    D from_source(int64_t x, int64_t y, int64_t z) {
-        return inner_source.get_density(RegularVoxelIndex{ x, y, z });
+    /**
+    Whether an extraction for the same `thresholds` as `samples_placeholders`, with `transition_sides`, would find
+    all its voxels loaded
+    */
+    bool loaded_for(const std::array<D, 2>* thresholds, TransitionSides transition_sides) {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        return regular_cache_loaded && !placeholders_in_the_way(thresholds) &&
+               (transition_sides & ~transition_cache_loaded).none();
     }
 
-    void load_regular_extended_voxels() {
-        if (regular_cache_extended_loaded) {
-            return;
-        } else {
-            regular_cache_extended_loaded = true;
+    bool placeholders_in_the_way(const std::array<D, 2>* thresholds) const {
+        if (placeholder_tiles.empty()) {
+            return false;
         }
+        return thresholds == nullptr || (*thresholds)[0] < placeholder_lowest_threshold ||
+               placeholder_highest_threshold < (*thresholds)[1];
+    }
+
+    /**
+    Loads all the block voxels, placeholders of adaptive sampling included, for reads outside of extractions: waits
+    for the extractions reading the cache to sample the placeholders
+    */
+    void sample_regular_block_voxels() {
+        std::unique_lock<std::shared_mutex> sampling_placeholders(placeholders_mutex);
+        load_regular_block_voxels();
+    }
+
+    size_t placeholder_tiles_per_side() const {
+        // Tiles own disjoint ranges of voxels, the last one along each axis being smaller
+        return (block_subdivisions + placeholder_tile_size) / placeholder_tile_size;
+    }
+
+    /**
+    Samples one tile of `placeholder_tiles`, or with `thresholds` (lowest and highest), puts placeholders instead
+    if the source bounds allow. Returns whether it did
+    */
+    bool load_tile(size_t item, const std::array<D, 2>* thresholds) {
         const size_t subs = block_subdivisions;
-        const size_t face_size = (subs + 1) * (subs + 1);
-        regular_cache_extended.resize(6 * face_size);
-        // -x
-        for (size_t y = 0; y <= subs; ++y) {
-            for (size_t z = 0; z <= subs; ++z) {
-                const size_t index = 0 * face_size + (subs + 1) * y + z;
-                regular_cache_extended[index] = from_source(-1, y, z);
-            }
+        const size_t tiles = placeholder_tiles_per_side();
+        const size_t tile[3] = { item / (tiles * tiles), (item / tiles) % tiles, item % tiles };
+        VoxelCoordinate low[3];
+        VoxelCoordinate high[3]; // excluded
+        for (size_t axis = 0; axis < 3; ++axis) {
+            low[axis] = static_cast<VoxelCoordinate>(tile[axis] * placeholder_tile_size);
+            high[axis] = static_cast<VoxelCoordinate>(std::min((tile[axis] + 1) * placeholder_tile_size, subs + 1));
         }
-        // +x
-        for (size_t y = 0; y <= subs; ++y) {
-            for (size_t z = 0; z <= subs; ++z) {
-                const size_t index = 1 * face_size + (subs + 1) * y + z;
-                regular_cache_extended[index] = from_source(subs + 1, y, z);
-            }
+        std::optional<DensityBounds<D>> bounds;
+        if (thresholds != nullptr) {
+            bounds = region_density_bounds(to_voxel_index(low[0] - 2, low[1] - 2, low[2] - 2),
+                                           to_voxel_index(high[0] + 1, high[1] + 1, high[2] + 1));
         }
-        // -y
-        for (size_t x = 0; x <= subs; ++x) {
-            for (size_t z = 0; z <= subs; ++z) {
-                const size_t index = 2 * face_size + (subs + 1) * x + z;
-                regular_cache_extended[index] = from_source(x, -1, z);
+        const bool all_inside = bounds && Density<D>::inside(bounds->min, (*thresholds)[1]);
+        const bool all_outside = bounds && !Density<D>::inside(bounds->max, (*thresholds)[0]);
+        const size_t row_size = static_cast<size_t>(high[2] - low[2]);
+        std::vector<D> row;
+        for (VoxelCoordinate x = low[0]; x < high[0]; ++x) {
+            for (VoxelCoordinate y = low[1]; y < high[1]; ++y) {
+                if (all_inside || all_outside) {
+                    row.assign(row_size, all_inside ? bounds->min : bounds->max);
+                    store_cache_row(x, y, low[2], row_size, row.data());
+                } else {
+                    load_cache_row(x, y, low[2], row_size, row);
+                }
             }
         }
-        // +y
-        for (size_t x = 0; x <= subs; ++x) {
-            for (size_t z = 0; z <= subs; ++z) {
-                const size_t index = 3 * face_size + (subs + 1) * x + z;
-                regular_cache_extended[index] = from_source(x, subs + 1, z);
-            }
+        return all_inside || all_outside;
+    }
+
+    void allocate_regular_cache() {
+        if (regular_cache.empty()) {
+            regular_cache.resize(regular_cache_size());
         }
-        // -z
-        for (size_t x = 0; x <= subs; ++x) {
-            for (size_t y = 0; y <= subs; ++y) {
-                const size_t index = 4 * face_size + (subs + 1) * x + y;
-                regular_cache_extended[index] = from_source(x, y, -1);
-            }
+    }
+
+    size_t regular_cache_size() const {
+        return regular_cache_size(block_subdivisions, cache_layout);
+    }
+
+    static size_t regular_cache_size(size_t block_subdivisions, DensityCacheLayout cache_layout) {
+        // Block voxels plus one layer on each side
+        const size_t padded_side = block_subdivisions + 3;
+        if (cache_layout == DensityCacheLayout::Linear) {
+            return padded_side * padded_side * padded_side;
         }
-        // +z
-        for (size_t x = 0; x <= subs; ++x) {
-            for (size_t y = 0; y <= subs; ++y) {
-                const size_t index = 5 * face_size + (subs + 1) * x + y;
-                regular_cache_extended[index] = from_source(x, y, subs + 1);
-            }
+        const size_t tiles = (padded_side + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE;
+        return tiles * tiles * tiles * CACHE_TILE_SIZE * CACHE_TILE_SIZE * CACHE_TILE_SIZE;
+    }
+
+    /**
+    Where a voxel of the block, or of the layer out of it (-1 and subdivisions + 1), is in `regular_cache`
+    */
+    size_t regular_cache_index(VoxelCoordinate x, VoxelCoordinate y, VoxelCoordinate z) const {
+        const size_t padded_side = block_subdivisions + 3;
+        const size_t px = static_cast<size_t>(x + 1);
+        const size_t py = static_cast<size_t>(y + 1);
+        const size_t pz = static_cast<size_t>(z + 1);
+        if (cache_layout == DensityCacheLayout::Linear) {
+            return padded_side * padded_side * px + padded_side * py + pz;
         }
+        constexpr size_t T = CACHE_TILE_SIZE;
+        const size_t tiles = (padded_side + T - 1) / T;
+        // Tile, then voxel in the tile, each one in X, Y, Z order
+        return T * T * T * (tiles * (tiles * (px / T) + py / T) + pz / T)
+            + T * T * (px % T) + T * (py % T) + pz % T;
     }
 
-    void load_transition_voxels(TransitionSides transition_sides) {
-        if (transition_cache_loaded) {
+    D from_source(VoxelCoordinate x, VoxelCoordinate y, VoxelCoordinate z) {
+        return inner_source.get_density(RegularVoxelIndex{ x, y, z });
+    }
+
+    /**
+    Samples `count` voxels along Z into the cache. `buffer` holds them on the way when they are not contiguous there
+    */
+    void load_cache_row(VoxelCoordinate x, VoxelCoordinate y, VoxelCoordinate z, size_t count, std::vector<D>& buffer) {
+        if (cache_layout == DensityCacheLayout::Linear) {
+            load_row(x, y, z, count, &regular_cache[regular_cache_index(x, y, z)]);
+        } else {
+            buffer.resize(count);
+            load_row(x, y, z, count, buffer.data());
+            store_cache_row(x, y, z, count, buffer.data());
+        }
+    }
+
+    void store_cache_row(VoxelCoordinate x, VoxelCoordinate y, VoxelCoordinate z, size_t count, const D* densities) {
+        if (cache_layout == DensityCacheLayout::Linear) {
+            std::copy(densities, densities + count, &regular_cache[regular_cache_index(x, y, z)]);
             return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            regular_cache[regular_cache_index(x, y, z + static_cast<VoxelCoordinate>(i))] = densities[i];
+        }
+    }
+
+    /**
+    Samples `count` voxels along Z, through the bulk path of the source when it has one
+    */
+    void load_row(VoxelCoordinate x, VoxelCoordinate y, VoxelCoordinate z, size_t count, D* densities) {
+        if constexpr (requires { inner_source.get_density_row(RegularVoxelIndex{ x, y, z }, count, densities); }) {
+            inner_source.get_density_row(RegularVoxelIndex{ x, y, z }, count, densities);
         } else {
-            transition_cache_loaded = true;
+            for (size_t i = 0; i < count; ++i) {
+                densities[i] = from_source(x, y, z + static_cast<VoxelCoordinate>(i));
+            }
         }
-        size_t num_transitions = 0;
-        // for (auto side : transition_sides) {
-        for(uint8_t side = 0; side < 6; ++side) {
-            if(!transition_sides.test(side)) {
-                continue;
+    }
+
+    void load_regular_extended_voxels() {
+        if (regular_cache_extended_loaded.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(load_mutex);
+        if (regular_cache_extended_loaded.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const size_t subs = block_subdivisions;
+        allocate_regular_cache();
+        // One item per row of a face: faces are ordered -x, +x, -y, +y, -z, +z, and within
+        // a face, rows follow the first of the two remaining coordinates
+        const VoxelCoordinate outside_high = static_cast<VoxelCoordinate>(subs) + 1;
+        for_each_item(6 * (subs + 1), [&](size_t item) {
+            const size_t face = item / (subs + 1);
+            const VoxelCoordinate a = static_cast<VoxelCoordinate>(item % (subs + 1));
+            const VoxelCoordinate outside = (face % 2 == 0) ? -1 : outside_high;
+            std::vector<D> row;
+            switch (face / 2) {
+            case 0:
+                load_cache_row(outside, a, 0, subs + 1, row);
+                break;
+            case 1:
+                load_cache_row(a, outside, 0, subs + 1, row);
+                break;
+            default:
+                // Rows of the Z faces run along Y
+                for (size_t b = 0; b <= subs; ++b) {
+                    regular_cache[regular_cache_index(a, b, outside)] = from_source(a, b, outside);
+                }
+                break;
             }
-            transition_cache_slices.insert({ side, num_transitions });
-            ++num_transitions;
+        });
+        regular_cache_extended_loaded.store(true, std::memory_order_release);
+    }
+
+    /**
+    Loads the sides of `transition_sides` not loaded yet
+    */
+    void load_transition_voxels(TransitionSides transition_sides) {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        const TransitionSides missing = transition_sides & ~transition_cache_loaded;
+        if (missing.none()) {
+            return;
         }
-        // We will only store the w=0 voxels, and not the ones out of the block (so, all voxels for case computations, and vertex positions, but not for gradients)
-        // For simplicity (at the cost of compactness) we store a sparse array also containing regular voxels on the face, that will never get read/written
+        // For simplicity (at the cost of compactness) we store a sparse array also containing regular voxels on the
+        // face, and corners of the layers that are never read/written
         const size_t subs = block_subdivisions;
-        const size_t size_per_face = (2 * subs + 1) * (2 * subs + 1);
-        transition_cache.resize(num_transitions * size_per_face);
-        for(uint8_t side = 0; side < 6; ++side) {
-            if(!transition_sides.test(side)) {
+        const size_t size_per_face = transition_cache_size(subs);
+        std::vector<TransitionSide> sides;
+        for (uint8_t side = 0; side < 6; ++side) {
+            if (!missing.test(side)) {
                 continue;
             }
-            for (size_t cell_u = 0; cell_u < subs; ++cell_u) {
+            transition_cache[side].resize(size_per_face);
+            sides.push_back(static_cast<TransitionSide>(side));
+        }
+        // One item per row of cells along U, plus one per side for the column at the highest U
+        for_each_item(sides.size() * (subs + 1), [&](size_t item) {
+            const TransitionSide side = sides[item / (subs + 1)];
+            const size_t cell_u = item % (subs + 1);
+            if (cell_u < subs) {
                 for (size_t cell_v = 0; cell_v < subs; ++cell_v) {
-                    cache_transition_voxel(from_transition_side(
-                        static_cast<TransitionSide>(side), cell_u, cell_v, 1, 0, 0));
-                    cache_transition_voxel(from_transition_side(
-                        static_cast<TransitionSide>(side), cell_u, cell_v, 0, 1, 0));
-                    cache_transition_voxel(from_transition_side(
-                        static_cast<TransitionSide>(side), cell_u, cell_v, 1, 1, 0));
+                    cache_transition_voxel(from_transition_side(side, cell_u, cell_v, 1, 0, 0));
+                    cache_transition_voxel(from_transition_side(side, cell_u, cell_v, 0, 1, 0));
+                    cache_transition_voxel(from_transition_side(side, cell_u, cell_v, 1, 1, 0));
+                }
+                cache_transition_voxel(from_transition_side(side, cell_u, subs - 1, 1, 2, 0));
+            } else {
+                for (size_t cell_v = 0; cell_v < subs; ++cell_v) {
+                    cache_transition_voxel(from_transition_side(side, subs - 1, cell_v, 2, 1, 0));
                 }
-                cache_transition_voxel(from_transition_side(
-                    static_cast<TransitionSide>(side), cell_u, subs - 1, 1, 2, 0));
             }
-            for (size_t cell_v = 0; cell_v < subs; ++cell_v) {
-                cache_transition_voxel(from_transition_side(
-                    static_cast<TransitionSide>(side), subs - 1, cell_v, 2, 1, 0));
+        });
+        // Then what the gradients of the voxels off the regular grid read: one row per U of the face and around it
+        const VoxelCoordinate face_high = 2 * static_cast<VoxelCoordinate>(subs);
+        for_each_item(sides.size() * (2 * subs + 3), [&](size_t item) {
+            const TransitionSide side = sides[item / (2 * subs + 3)];
+            const VoxelCoordinate u = static_cast<VoxelCoordinate>(item % (2 * subs + 3)) - 1;
+            const bool u_in_face = u >= 0 && u <= face_high;
+            for (VoxelCoordinate v = -1; v <= face_high + 1; ++v) {
+                const bool v_in_face = v >= 0 && v <= face_high;
+                const bool off_regular_grid = u % 2 != 0 || v % 2 != 0;
+                if (u_in_face && v_in_face) {
+                    if (off_regular_grid) {
+                        cache_off_face_voxel(side, u, v, -1);
+                        cache_off_face_voxel(side, u, v, 1);
+                    }
+                } else if ((u_in_face && u % 2 != 0) || (v_in_face && v % 2 != 0)) {
+                    cache_off_face_voxel(side, u, v, 0);
+                }
             }
-        }
+        });
+        transition_cache_loaded |= missing;
+    }
+
+    /**
+    Samples the voxel of global coordinates `u`, `v` (in half cells) and `w` around the high resolution face of
+    `side`. Never from the finer neighbours, which only know the face itself
+    */
+    void cache_off_face_voxel(TransitionSide side, VoxelCoordinate u, VoxelCoordinate v, VoxelCoordinate w) {
+        const VoxelCoordinate last_cell = static_cast<VoxelCoordinate>(block_subdivisions) - 1;
+        const VoxelCoordinate cell_u = std::clamp<VoxelCoordinate>(u / 2, 0, last_cell);
+        const VoxelCoordinate cell_v = std::clamp<VoxelCoordinate>(v / 2, 0, last_cell);
+        const auto voxel_index = from_transition_side(side, static_cast<size_t>(cell_u), static_cast<size_t>(cell_v),
+                                                      u - 2 * cell_u, v - 2 * cell_v, w);
+        transition_cache[static_cast<size_t>(side)][transition_cache_index(voxel_index)] =
+            inner_source.get_transition_density(voxel_index);
     }
 
     void cache_transition_voxel(const HighResolutionVoxelIndex& voxel_index) {
-        const D d = inner_source.get_transition_density(voxel_index);
-        const size_t cache_index = transition_cache_index(voxel_index);
-        transition_cache[cache_index] = d;
+        const auto* neighbour = transition_neighbours[static_cast<size_t>(voxel_index.cell.side)];
+        const D d = neighbour != nullptr
+            ? neighbour->get_density(to_higher_res_neighbour_block_index(voxel_index, block_subdivisions))
+            : inner_source.get_transition_density(voxel_index);
+        const size_t side = static_cast<size_t>(voxel_index.cell.side);
+        transition_cache[side][transition_cache_index(voxel_index)] = d;
     }
 
+    /**
+    Where a voxel of a high resolution face, or next to it, is in the `transition_cache` of its side: by W from -1
+    to 1, then by U and V from -1 to 2 * subdivisions + 1
+    */
     size_t transition_cache_index(const HighResolutionVoxelIndex& voxel_index) const {
-        const size_t side = static_cast<size_t>(voxel_index.cell.side);
-        const size_t cache_slice = transition_cache_slices.at(side);
-        const size_t subs = block_subdivisions;
-        const size_t size_per_face = (2 * subs + 1) * (2 * subs + 1);
-        const size_t slice_shift = cache_slice * size_per_face;
-        const int64_t global_du = 2 * static_cast<int64_t>(voxel_index.cell.cell_u) + voxel_index.delta.u;
-        const int64_t global_dv = 2 * static_cast<int64_t>(voxel_index.cell.cell_v) + voxel_index.delta.v;
-        const size_t index_in_slice = (2 * subs + 1) * static_cast<size_t>(global_du) +
-        static_cast<size_t>(global_dv);
-        return slice_shift + index_in_slice;
+        const size_t side = 2 * block_subdivisions + 3;
+        const VoxelCoordinate global_du = 2 * static_cast<VoxelCoordinate>(voxel_index.cell.cell_u) + voxel_index.delta.u;
+        const VoxelCoordinate global_dv = 2 * static_cast<VoxelCoordinate>(voxel_index.cell.cell_v) + voxel_index.delta.v;
+        [[maybe_unused]] const VoxelCoordinate high = 2 * static_cast<VoxelCoordinate>(block_subdivisions) + 1;
+        assert(global_du >= -1 && global_du <= high && global_dv >= -1 && global_dv <= high);
+        assert(voxel_index.delta.w >= -1 && voxel_index.delta.w <= 1);
+        return side * (side * static_cast<size_t>(voxel_index.delta.w + 1) + static_cast<size_t>(global_du + 1))
+            + static_cast<size_t>(global_dv + 1);
     }
 
-    D get_density(const RegularVoxelIndex& voxel_index) const {
-        const size_t x = voxel_index.x;
-        const size_t y = voxel_index.y;
-        const size_t z = voxel_index.z;
-        const size_t subs = block_subdivisions;
-        const size_t face_size = (subs + 1) * (subs + 1);
-
-        if (x == -1) {
-            assert(y >= 0 && y <= static_cast<size_t>(subs) && z >= 0 && z <= static_cast<size_t>(subs));
-            const size_t index = 0 * face_size + (subs + 1) * static_cast<size_t>(y) + static_cast<size_t>(z);
-            return regular_cache_extended[index];
-        } else if (x == static_cast<size_t>(subs) + 1) {
-            assert(y >= 0 && y <= static_cast<size_t>(subs) && z >= 0 && z <= static_cast<size_t>(subs));
-            const size_t index = 1 * face_size + (subs + 1) * static_cast<size_t>(y) + static_cast<size_t>(z);
-            return regular_cache_extended[index];
-        } else if (y == -1) {
-            assert(x >= 0 && x <= static_cast<size_t>(subs) && z >= 0 && z <= static_cast<size_t>(subs));
-            const size_t index = 2 * face_size + (subs + 1) * static_cast<size_t>(x) + static_cast<size_t>(z);
-            return regular_cache_extended[index];
-        } else if (y == static_cast<size_t>(subs) + 1) {
-            assert(x >= 0 && x <= static_cast<size_t>(subs) && z >= 0 && z <= static_cast<size_t>(subs));
-            const size_t index = 3 * face_size + (subs + 1) * static_cast<size_t>(x) + static_cast<size_t>(z);
-            return regular_cache_extended[index];
-        } else if (z == -1) {
-            assert(x >= 0 && x <= static_cast<size_t>(subs) && y >= 0 && y <= static_cast<size_t>(subs));
-            const size_t index = 4 * face_size + (subs + 1) * static_cast<size_t>(x) + static_cast<size_t>(y);
-            return regular_cache_extended[index];
-        } else if (z == static_cast<size_t>(subs) + 1) {
-            assert(x >= 0 && x <= static_cast<size_t>(subs) && y >= 0 && y <= static_cast<size_t>(subs));
-            const size_t index = 5 * face_size + (subs + 1) * static_cast<size_t>(x) + static_cast<size_t>(y);
-            return regular_cache_extended[index];
-        } else {
-            assert(x >= 0 && x <= static_cast<size_t>(subs) && y >= 0 && y <= static_cast<size_t>(subs) &&
-            z >= 0 && z <= static_cast<size_t>(subs));
-            const size_t index = regular_block_index(x, y, z);
-            return regular_cache[index];
+    static size_t transition_cache_size(size_t block_subdivisions) {
+        const size_t side = 2 * block_subdivisions + 3;
+        return 3 * side * side;
+    }
+
+    /**
+    Bytes taken by the cached voxels so far
+    */
+    size_t memory_size() const {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        size_t bytes = sizeof(*this) + regular_cache.capacity() * sizeof(D) + placeholder_tiles.capacity();
+        for (const auto& side : transition_cache) {
+            bytes += side.capacity() * sizeof(D);
         }
+        return bytes;
+    }
+
+    /**
+    Bytes the voxels of a cache take once all loaded, before knowing what an extraction will load: `memory_size`
+    never exceeds it but for the flags of adaptive sampling, one byte per tile
+    */
+    static size_t max_memory_size(size_t block_subdivisions, DensityCacheLayout cache_layout) {
+        return sizeof(PreCachingVoxelSource) +
+               (regular_cache_size(block_subdivisions, cache_layout) + 6 * transition_cache_size(block_subdivisions))
+               * sizeof(D);
+    }
+
+    D get_density(const RegularVoxelIndex& voxel_index) const {
+        const VoxelCoordinate x = voxel_index.x;
+        const VoxelCoordinate y = voxel_index.y;
+        const VoxelCoordinate z = voxel_index.z;
+        [[maybe_unused]] const VoxelCoordinate high = static_cast<VoxelCoordinate>(block_subdivisions);
+        assert(x >= -1 && x <= high + 1 && y >= -1 && y <= high + 1 && z >= -1 && z <= high + 1);
+        // Out of the block, only the faces are cached
+        assert((x < 0 || x > high ? 1 : 0) + (y < 0 || y > high ? 1 : 0) + (z < 0 || z > high ? 1 : 0) <= 1);
+        return regular_cache[regular_cache_index(x, y, z)];
     }
 
     D get_transition_density(const HighResolutionVoxelIndex& index) const {
         const auto c = index.cell;
-        const auto d = index.delta;
-        const auto subs = static_cast<size_t>(block_subdivisions);
-        assert(d.w != 0 || d.u % 2 != 0 || d.v % 2 != 0);
-        // The following check is only valid if, for voxels coinciding with a regular voxel,
-        // we also get the gradient from the regular voxel. Not sure this is correct (see
-        // `high_res_face_grid_point_gradient`)
-        if (d.w != 0) {
-            assert(d.u % 2 != 0 || d.v % 2 != 0);
-        }
-        if (d.w != 0 || static_cast<int64_t>(c.cell_u) * 2 + d.u < 0 || static_cast<int64_t>(c.cell_u) * 2 + d.u > 2 * subs ||
-            static_cast<int64_t>(c.cell_v) * 2 + d.v < 0 || static_cast<int64_t>(c.cell_v) * 2 + d.v > 2 * subs) {
-            // Out of the block face: we don't cache these
-            return inner_source.get_transition_density(index);
-        }
-        const auto cache_index = transition_cache_index(index);
-        return transition_cache[cache_index];
+        [[maybe_unused]] const auto d = index.delta;
+        // Voxels coinciding with a regular voxel are read from the regular cache, gradients included (see
+        // `high_res_face_grid_point_gradient`): only the others and their neighbours are cached here
+        assert(d.u % 2 != 0 || d.v % 2 != 0);
+        assert(!transition_cache[static_cast<size_t>(c.side)].empty());
+        return transition_cache[static_cast<size_t>(c.side)][transition_cache_index(index)];
     }
 };
\ No newline at end of file
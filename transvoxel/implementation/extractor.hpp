@@ -4,41 +4,70 @@
 #include "rotation.hpp"
 #include "transvoxel.h"
 #include "aux_tables.hpp"
+#include "case_codes.hpp"
+#include "case_tables.hpp"
 #include "table_wrappers.hpp"
+#include "vertex_kernels.hpp"
+#include "../mesh_bvh.hpp"
+#include "../mesh_optimization.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 template <typename F, typename D>
 struct GridPoint {
     Position<F> position;
     std::tuple<F, F, F> gradient;
     D density;
+    // Only filled when extracting with secondary positions
+    Position<F> secondary_position;
+    uint8_t border_sides;
 };
 
 struct SharedVertexIndices {
     std::vector<size_t> regular;
     std::vector<size_t> transition;
     size_t block_size;
+    /// Per `RegularCase::reuse_slot`, from the storage of a cell to the vertex the slot designates
+    std::array<int64_t, REGULAR_REUSE_SLOTS> regular_reuse_offsets;
 
     SharedVertexIndices(size_t block_size) :
         regular(4 * block_size * block_size * block_size, 0),
         transition(10 * 6 * block_size * block_size, 0),
-        block_size(block_size) {}
+        block_size(block_size),
+        regular_reuse_offsets()
+    {
+        const int64_t size = static_cast<int64_t>(block_size);
+        for (size_t slot = 0; slot < REGULAR_REUSE_SLOTS; ++slot) {
+            const size_t directions = slot / 4;
+            const int64_t reuse_index = static_cast<int64_t>(slot % 4);
+            regular_reuse_offsets[slot] = size * size * size * reuse_index
+                - ((directions & 1) ? size * size : 0)
+                - ((directions & 2) ? size : 0)
+                - ((directions & 4) ? 1 : 0);
+        }
+    }
+
+    /// Cells in the order of the extraction, so that the cells reused from are close by
+    size_t regular_cell_storage(size_t cell_x, size_t cell_y, size_t cell_z) const {
+        return block_size * block_size * cell_x + block_size * cell_y + cell_z;
+    }
 
-    size_t get_regular(size_t cell_x, size_t cell_y, size_t cell_z, size_t reuse_index) const {
-        size_t storage_index = cell_x
-            + block_size * cell_y
-            + block_size * block_size * cell_z
-            + block_size * block_size * block_size * reuse_index;
-        return regular[storage_index];
+    size_t get_regular(size_t cell_storage, uint8_t reuse_slot) const {
+        return regular[static_cast<size_t>(static_cast<int64_t>(cell_storage) + regular_reuse_offsets[reuse_slot])];
     }
 
-    void put_regular(size_t index, size_t cell_x, size_t cell_y, size_t cell_z, size_t reuse_index) {
-        size_t storage_index = cell_x
-            + block_size * cell_y
-            + block_size * block_size * cell_z
-            + block_size * block_size * block_size * reuse_index;
-        regular[storage_index] = index;
+    void put_regular(size_t index, size_t cell_storage, uint8_t reuse_slot) {
+        regular[static_cast<size_t>(static_cast<int64_t>(cell_storage) + regular_reuse_offsets[reuse_slot])] = index;
     }
     size_t get_transition(const TransitionCellIndex& cell, const TransitionReuseIndex& reuse_index) const {
         size_t storage_index = static_cast<uint8_t>(cell.side)
@@ -55,6 +84,18 @@ struct SharedVertexIndices {
     }
 };
 
+inline uint8_t border_sides_of(VoxelCoordinate xi, VoxelCoordinate yi, VoxelCoordinate zi, size_t subdivisions) {
+    const VoxelCoordinate high = static_cast<VoxelCoordinate>(subdivisions);
+    TransitionSides sides;
+    sides.set(static_cast<size_t>(TransitionSide::LowX), xi == 0);
+    sides.set(static_cast<size_t>(TransitionSide::HighX), xi == high);
+    sides.set(static_cast<size_t>(TransitionSide::LowY), yi == 0);
+    sides.set(static_cast<size_t>(TransitionSide::HighY), yi == high);
+    sides.set(static_cast<size_t>(TransitionSide::LowZ), zi == 0);
+    sides.set(static_cast<size_t>(TransitionSide::HighZ), zi == high);
+    return static_cast<uint8_t>(sides.to_ulong());
+}
+
 inline bool can_shrink(size_t xi, size_t yi, size_t zi, size_t subdivisions,
                 const TransitionSides &transition_sides) {
     bool dont_shrink =
@@ -97,148 +138,497 @@ void _shrink_if_needed(F &x, F &y, F &z,
     }
 }
 
+/**
+Edge crossings that have a vertex index, but not yet a position and normal: these are computed by batches.
+Structure of arrays, for the SIMD kernel of `vertex_kernels.hpp`
+*/
+template <typename F, typename D>
+struct PendingVertices {
+    std::vector<D> density_a;
+    std::vector<D> density_b;
+    std::array<std::vector<F>, 3> position_a;
+    std::array<std::vector<F>, 3> position_b;
+    std::array<std::vector<F>, 3> gradient_a;
+    std::array<std::vector<F>, 3> gradient_b;
+    /// Only filled when extracting with secondary positions
+    std::array<std::vector<F>, 3> secondary_a;
+    std::array<std::vector<F>, 3> secondary_b;
+
+    size_t size() const {
+        return density_a.size();
+    }
+
+    void push(const GridPoint<F, D>& a, const GridPoint<F, D>& b, bool with_secondary_positions) {
+        density_a.push_back(a.density);
+        density_b.push_back(b.density);
+        const F a_position[3] = { a.position.x, a.position.y, a.position.z };
+        const F b_position[3] = { b.position.x, b.position.y, b.position.z };
+        const F a_gradient[3] = { std::get<0>(a.gradient), std::get<1>(a.gradient), std::get<2>(a.gradient) };
+        const F b_gradient[3] = { std::get<0>(b.gradient), std::get<1>(b.gradient), std::get<2>(b.gradient) };
+        for (size_t axis = 0; axis < 3; ++axis) {
+            position_a[axis].push_back(a_position[axis]);
+            position_b[axis].push_back(b_position[axis]);
+            gradient_a[axis].push_back(a_gradient[axis]);
+            gradient_b[axis].push_back(b_gradient[axis]);
+        }
+        if (with_secondary_positions) {
+            const F a_secondary[3] = { a.secondary_position.x, a.secondary_position.y, a.secondary_position.z };
+            const F b_secondary[3] = { b.secondary_position.x, b.secondary_position.y, b.secondary_position.z };
+            for (size_t axis = 0; axis < 3; ++axis) {
+                secondary_a[axis].push_back(a_secondary[axis]);
+                secondary_b[axis].push_back(b_secondary[axis]);
+            }
+        }
+    }
+
+    void clear() {
+        density_a.clear();
+        density_b.clear();
+        for (size_t axis = 0; axis < 3; ++axis) {
+            position_a[axis].clear();
+            position_b[axis].clear();
+            gradient_a[axis].clear();
+            gradient_b[axis].clear();
+            secondary_a[axis].clear();
+            secondary_b[axis].clear();
+        }
+    }
+};
+
 template<typename F, typename D, typename S>
 struct Extractor {
-    PreCachingVoxelSource<D, S> density_source;
+    std::shared_ptr<PreCachingVoxelSource<D, S>> voxel_cache;
+    /// `*voxel_cache`
+    PreCachingVoxelSource<D, S>* density_source;
+    /// Whether other extractions may use `voxel_cache`
+    bool cache_shared;
+    /// Once the block is loaded, keeps other extractions of a shared cache from sampling its placeholders
+    std::shared_lock<std::shared_mutex> reading_placeholders;
     Block<F> block;
     D threshold;
+    /// Thresholds the regular voxels are sampled for, when one extraction makes meshes for several of them
+    D lowest_threshold;
+    D highest_threshold;
     TransitionSides transition_sides;
     size_t vertices;
     std::vector<F> vertices_positions;
     std::vector<F> vertices_normals;
     std::vector<size_t> tri_indices;
+    MeshBounds<F> vertices_bounds;
+    bool with_secondary_positions;
+    std::vector<F> vertices_secondary_positions;
+    std::vector<uint8_t> vertices_border_sides;
     SharedVertexIndices shared_storage;
     Rotation current_rotation;
-
-
-    Extractor(S density_source, const Block<F> &block, D threshold, TransitionSides transition_sides)
-        : density_source(PreCachingVoxelSource<D, S>(density_source, block.subdivisions)),
+    const std::atomic<bool>* cancelled;
+    bool adaptive_sampling;
+    bool optimize_for_rendering;
+    bool with_meshlets;
+    bool with_bvh;
+    bool fast_normals;
+    PendingVertices<F, D> pending_vertices;
+
+    /// Cells per side of the tiles sampled as a whole by the adaptive sampling
+    static constexpr size_t ADAPTIVE_TILE_SIZE = 4;
+
+    Extractor(S density_source, const Block<F> &block, D threshold, TransitionSides transition_sides,
+              const ExtractionOptions& options = {})
+        : Extractor(std::make_shared<PreCachingVoxelSource<D, S>>(std::move(density_source), block.subdivisions,
+                                                                  options.executor, options.cache_layout),
+                    block, threshold, transition_sides, options)
+    {
+        cache_shared = false;
+    }
+
+    /**
+    Extracts from voxels cached by previous extractions of the same block, loading only what they did not.
+    The executor and cache layout of `options` are the ones of the cache
+    */
+    Extractor(std::shared_ptr<PreCachingVoxelSource<D, S>> voxel_cache, const Block<F> &block, D threshold,
+              TransitionSides transition_sides, const ExtractionOptions& options = {})
+        : voxel_cache(std::move(voxel_cache)),
+        density_source(this->voxel_cache.get()),
+        cache_shared(true),
+        reading_placeholders(),
         block(block),
         threshold(threshold),
+        lowest_threshold(threshold),
+        highest_threshold(threshold),
         transition_sides(transition_sides),
         vertices(0),
         vertices_positions(),
         vertices_normals(),
         tri_indices(),
+        vertices_bounds(),
+        with_secondary_positions(false),
+        vertices_secondary_positions(),
+        vertices_border_sides(),
         shared_storage(block.subdivisions),
-        current_rotation(Rotation::create_default())
-    {}
+        current_rotation(Rotation::create_default()),
+        cancelled(options.cancelled),
+        adaptive_sampling(options.adaptive_sampling),
+        optimize_for_rendering(options.optimize_for_rendering || options.build_meshlets),
+        with_meshlets(options.build_meshlets),
+        with_bvh(options.build_bvh),
+        fast_normals(options.fast_normals),
+        pending_vertices()
+    {
+        assert(block.subdivisions <= MAX_BLOCK_SUBDIVISIONS);
+        assert(density_source->block_subdivisions == block.subdivisions);
+    }
 
     Mesh<F> extract() {
+        if (!load_block()) {
+            return output_mesh();
+        }
         extract_regular_cells();
-        extract_transition_cells();
+        if (!is_cancelled()) {
+            extract_transition_cells();
+        }
         return output_mesh();
     }
 
+    /**
+    One mesh per threshold, in their order. The voxels are sampled once, for all of them
+    */
+    std::vector<Mesh<F>> extract_multi(std::span<const D> thresholds) {
+        std::vector<Mesh<F>> meshes;
+        if (thresholds.empty()) {
+            return meshes;
+        }
+        meshes.reserve(thresholds.size());
+        lowest_threshold = *std::min_element(thresholds.begin(), thresholds.end());
+        highest_threshold = *std::max_element(thresholds.begin(), thresholds.end());
+        for (const D& next_threshold : thresholds) {
+            threshold = next_threshold;
+            meshes.push_back(extract());
+            clear_output();
+        }
+        return meshes;
+    }
+
+    /**
+    Loads the block densities. Returns false, without loading anything, if the source can prove there is no
+    surface in the block. Not asked when all the voxels are loaded already
+    */
+    bool load_block() {
+        const std::array<D, 2> thresholds = { lowest_threshold, highest_threshold };
+        const std::array<D, 2>* sampled_range = adaptive_sampling ? &thresholds : nullptr;
+        // With nothing left to load, the bounds would only cost source queries
+        if (!density_source->loaded_for(sampled_range, transition_sides) && block_proven_uniform()) {
+            return false;
+        }
+        if (cache_shared && density_source->samples_placeholders(sampled_range)) {
+            // Other extractions may be reading the placeholders: wait for them to finish before sampling them in
+            // place. Loads only ever replace placeholders, so the ones left after are still fine for this one
+            if (reading_placeholders.owns_lock()) {
+                reading_placeholders.unlock();
+            }
+            std::unique_lock<std::shared_mutex> sampling_placeholders(density_source->placeholders_mutex);
+            load_regular_voxels();
+        } else {
+            load_regular_voxels();
+        }
+        if (cache_shared) {
+            if (!reading_placeholders.owns_lock()) {
+                reading_placeholders = std::shared_lock<std::shared_mutex>(density_source->placeholders_mutex);
+            }
+            // The cells classify the layer out of the block with the block voxels: it cannot be loaded lazily while
+            // other extractions may be doing so
+            density_source->load_regular_extended_voxels();
+        }
+        return true;
+    }
+
+    void load_regular_voxels() {
+        if (adaptive_sampling) {
+            density_source->load_regular_block_voxels_adaptive(ADAPTIVE_TILE_SIZE, lowest_threshold,
+                                                              highest_threshold);
+        } else {
+            density_source->load_regular_block_voxels();
+        }
+    }
+
+    /**
+    Whether the source density bounds prove that all the voxels sampled for the block (gradients included) are
+    on the same side of the surface. Bounds get tighter on smaller regions: when the whole block is not
+    conclusive, tries again with 2^3 then 4^3 parts, as long as that takes fewer queries than there are voxels
+    */
+    bool block_proven_uniform() {
+        // Other extractions of a shared cache may be sampling a source that does not allow concurrent calls
+        std::unique_lock<std::mutex> querying(density_source->load_mutex, std::defer_lock);
+        if (cache_shared && !FieldThreading<S>::thread_safe()) {
+            querying.lock();
+        }
+        // Gradients sample one voxel beyond the block on every side
+        const VoxelCoordinate low = -1;
+        const VoxelCoordinate extent = static_cast<VoxelCoordinate>(block.subdivisions) + 2;
+        // Beyond int32 from about 1290 subdivisions
+        const uint64_t voxels_per_side = static_cast<uint64_t>(extent) + 1;
+        const uint64_t voxel_count = voxels_per_side * voxels_per_side * voxels_per_side;
+        for (VoxelCoordinate parts = 1; parts <= 4 && static_cast<uint64_t>(parts * parts * parts) < voxel_count;
+             parts *= 2) {
+            bool conclusive = true;
+            bool any_inside = false;
+            bool any_outside = false;
+            for (VoxelCoordinate i = 0; i < parts * parts * parts && conclusive; ++i) {
+                const VoxelCoordinate part[3] = { i % parts, (i / parts) % parts, i / (parts * parts) };
+                VoxelCoordinate part_low[3];
+                VoxelCoordinate part_high[3];
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    part_low[axis] = low + extent * part[axis] / parts;
+                    part_high[axis] = low + extent * (part[axis] + 1) / parts;
+                }
+                const auto bounds = density_source->region_density_bounds(
+                    to_voxel_index(part_low[0], part_low[1], part_low[2]),
+                    to_voxel_index(part_high[0], part_high[1], part_high[2]));
+                if (!bounds) {
+                    return false;
+                }
+                const bool all_inside = Density<D>::inside(bounds->min, threshold);
+                const bool all_outside = !Density<D>::inside(bounds->max, threshold);
+                if ((all_inside && any_outside) || (all_outside && any_inside)) {
+                    // The surface lies between two parts
+                    return false;
+                }
+                any_inside = any_inside || all_inside;
+                any_outside = any_outside || all_outside;
+                conclusive = all_inside || all_outside;
+            }
+            if (conclusive) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+    Extracts the regular cells and the transition cells of all 6 sides as separate meshes, with secondary
+    positions instead of shrinking. The transition sides given to the constructor are ignored
+    */
+    LayeredMesh<F> extract_layered() {
+        with_secondary_positions = true;
+        transition_sides.reset();
+        LayeredMesh<F> layered;
+        if (!load_block()) {
+            return layered;
+        }
+        extract_regular_cells();
+        layered.regular = output_mesh_with_secondary_positions();
+        if (is_cancelled()) {
+            return layered;
+        }
+        density_source->load_transition_voxels(TransitionSides().set());
+        for (size_t side = 0; side < 6 && !is_cancelled(); ++side) {
+            extract_transition_cells_on_side(static_cast<TransitionSide>(side));
+            layered.transitions[side] = output_mesh_with_secondary_positions();
+        }
+        return layered;
+    }
+
+    MeshWithSecondaryPositions<F> output_mesh_with_secondary_positions() {
+        MeshWithSecondaryPositions<F> result{
+            output_mesh(),
+            std::move(vertices_secondary_positions),
+            std::move(vertices_border_sides)
+        };
+        clear_output();
+        return result;
+    }
+
+    /**
+    Starts the next mesh. Vertex reuse needs no reset: cells only reuse vertices of the same mesh
+    */
+    void clear_output() {
+        vertices = 0;
+        vertices_positions.clear();
+        vertices_normals.clear();
+        tri_indices.clear();
+        vertices_secondary_positions.clear();
+        vertices_border_sides.clear();
+    }
+
+    bool is_cancelled() const {
+        return cancelled != nullptr && cancelled->load(std::memory_order_relaxed);
+    }
+
     Mesh<F> output_mesh() {
-        return Mesh<F>(
+        finish_pending_vertices();
+        Mesh<F> mesh(
             std::move(vertices_positions),
             std::move(vertices_normals),
             std::move(tri_indices));
+        mesh.bounds = vertices_bounds;
+        mesh.bounds.shrink_sphere_to_box();
+        vertices_bounds = MeshBounds<F>();
+        if (optimize_for_rendering && !is_cancelled()) {
+            prepare_for_rendering(mesh);
+        }
+        if (with_bvh && !is_cancelled()) {
+            mesh.bvh = std::make_shared<const MeshBvh<F>>(mesh);
+        }
+        return mesh;
+    }
+
+    void prepare_for_rendering(Mesh<F>& mesh) {
+        const auto remap = optimize_mesh(mesh);
+        if (with_secondary_positions) {
+            remap_vertex_attribute(vertices_secondary_positions, remap, 3);
+            remap_vertex_attribute(vertices_border_sides, remap, 1);
+        }
+        if (with_meshlets) {
+            build_meshlets(mesh);
+        }
     }
 
     void extract_regular_cells() {
-        for (size_t cell_x = 0; cell_x < block.subdivisions; ++cell_x) {
-            for (size_t cell_y = 0; cell_y < block.subdivisions; ++cell_y) {
-                for (size_t cell_z = 0; cell_z < block.subdivisions; ++cell_z) {
-                    RegularCellIndex cell_index { cell_x, cell_y, cell_z };
-                    extract_regular_cell(cell_index);
+        if (density_source->cache_layout == DensityCacheLayout::Tiled) {
+            extract_regular_cells_by_tiles();
+            return;
+        }
+        const size_t subs = block.subdivisions;
+        const size_t padded_side = subs + 3;
+        // Inside flags of the voxels of the X slices on both sides of the current slice of cells, with the layer
+        // out of the block like the cache
+        std::vector<uint8_t> inside_low(padded_side * padded_side);
+        std::vector<uint8_t> inside_high(padded_side * padded_side);
+        std::vector<uint8_t> case_codes(subs);
+        const auto row = [padded_side](std::vector<uint8_t>& inside, size_t y) {
+            return &inside[padded_side * (y + 1) + 1];
+        };
+        classify_voxel_slice(0, inside_low.data());
+        for (size_t cell_x = 0; cell_x < subs; ++cell_x) {
+            if (is_cancelled()) {
+                return;
+            }
+            classify_voxel_slice(cell_x + 1, inside_high.data());
+            for (size_t cell_y = 0; cell_y < subs; ++cell_y) {
+                combine_case_codes(row(inside_low, cell_y), row(inside_high, cell_y),
+                                   row(inside_low, cell_y + 1), row(inside_high, cell_y + 1),
+                                   subs, case_codes.data());
+                for (size_t cell_z = 0; cell_z < subs; ++cell_z) {
+                    extract_regular_cell(to_cell_index(cell_x, cell_y, cell_z), case_codes[cell_z]);
                 }
             }
+            finish_pending_vertices();
+            std::swap(inside_low, inside_high);
         }
     }
 
-    void extract_regular_cell(const RegularCellIndex& cell_index) {
-        const uint8_t case_number = regular_cell_case(cell_index);
-        const uint8_t cell_class = regularCellClass[case_number];
-        if (cell_class != 0) {
-            // To optimize, we could also check if the cell is on a border of the block, here
-            // we only need voxels out of the block when such a cell generates vertices, because
-            // these are for vertex normals
-            density_source.load_regular_extended_voxels();
-        }
-        const RegularCellData& triangulation_info = regularCellData[cell_class];
-        const auto& vertices_data = regularVertexData[case_number];
-        std::array<size_t, 12> cell_vertices_indices {};
-        for (size_t i = 0; i < VERTEX_DATA_LENGTH; ++i) {
-            if (i >= triangulation_info.GetVertexCount()) {
-                break;
+    void classify_voxel_slice(size_t x, uint8_t* inside) const {
+        const size_t padded_side = block.subdivisions + 3;
+        const D* densities = &density_source->regular_cache[density_source->regular_cache_index(x, -1, -1)];
+        classify_densities(densities, padded_side * padded_side, threshold, inside);
+    }
+
+    /**
+    `extract_regular_cells` for the tiled cache: classifies all its voxels at once, in its order, then visits the
+    cells by tiles of the same size. Tiles go in X, Y, Z order, so the cells a cell reuses vertices from still
+    come before it
+    */
+    void extract_regular_cells_by_tiles() {
+        const auto& densities = density_source->regular_cache;
+        std::vector<uint8_t> inside(densities.size());
+        classify_densities(densities.data(), densities.size(), threshold, inside.data());
+        const size_t subs = block.subdivisions;
+        constexpr size_t TILE = PreCachingVoxelSource<D, S>::CACHE_TILE_SIZE;
+        constexpr size_t SIDE = TILE + 1;
+        // Offsets of the corners of a cell in `tile_inside`, with the bits of `REGULAR_CELL_VOXELS`
+        constexpr std::array<size_t, 8> CORNER_OFFSETS = {
+            0, SIDE * SIDE, SIDE, SIDE * SIDE + SIDE, 1, SIDE * SIDE + 1, SIDE + 1, SIDE * SIDE + SIDE + 1
+        };
+        // Inside flags of the voxels of the cells of a tile
+        std::array<uint8_t, SIDE * SIDE * SIDE> tile_inside;
+        const size_t tiles = (subs + TILE - 1) / TILE;
+        for (size_t tile_x = 0; tile_x < tiles; ++tile_x) {
+            if (is_cancelled()) {
+                return;
             }
-            cell_vertices_indices[i] = regular_vertex(cell_index, RegularVertexData{.data=vertices_data[i]});
-        }
-        for (size_t t = 0; t < triangulation_info.GetTriangleCount(); ++t) {
-            const size_t v1_index_in_cell = triangulation_info.vertexIndex[3 * t];
-            const size_t v2_index_in_cell = triangulation_info.vertexIndex[3 * t + 1];
-            const size_t v3_index_in_cell = triangulation_info.vertexIndex[3 * t + 2];
-            const size_t global_index_1 = cell_vertices_indices[v1_index_in_cell];
-            const size_t global_index_2 = cell_vertices_indices[v2_index_in_cell];
-            const size_t global_index_3 = cell_vertices_indices[v3_index_in_cell];
-            tri_indices.push_back(global_index_1);
-            tri_indices.push_back(global_index_2);
-            tri_indices.push_back(global_index_3);
+            for (size_t tile_y = 0; tile_y < tiles; ++tile_y) {
+                for (size_t tile_z = 0; tile_z < tiles; ++tile_z) {
+                    const size_t low[3] = { TILE * tile_x, TILE * tile_y, TILE * tile_z };
+                    const size_t cells[3] = {
+                        std::min(TILE, subs - low[0]), std::min(TILE, subs - low[1]), std::min(TILE, subs - low[2])
+                    };
+                    for (size_t x = 0; x <= cells[0]; ++x) {
+                        for (size_t y = 0; y <= cells[1]; ++y) {
+                            for (size_t z = 0; z <= cells[2]; ++z) {
+                                tile_inside[SIDE * SIDE * x + SIDE * y + z] = inside[
+                                    density_source->regular_cache_index(low[0] + x, low[1] + y, low[2] + z)];
+                            }
+                        }
+                    }
+                    for (size_t x = 0; x < cells[0]; ++x) {
+                        for (size_t y = 0; y < cells[1]; ++y) {
+                            for (size_t z = 0; z < cells[2]; ++z) {
+                                const uint8_t* corner = &tile_inside[SIDE * SIDE * x + SIDE * y + z];
+                                uint8_t case_number = 0;
+                                for (size_t bit = 0; bit < 8; ++bit) {
+                                    case_number |= static_cast<uint8_t>(corner[CORNER_OFFSETS[bit]] << bit);
+                                }
+                                extract_regular_cell(to_cell_index(low[0] + x, low[1] + y, low[2] + z), case_number);
+                            }
+                        }
+                    }
+                }
+            }
+            finish_pending_vertices();
         }
     }
-    size_t regular_cell_case(const RegularCellIndex& cell_index) {
-        size_t case_number = 0;
-        for (size_t i = 0; i < REGULAR_CELL_VOXELS.size(); ++i) {
-            const auto& deltas = REGULAR_CELL_VOXELS[i];
-            const RegularVoxelIndex voxel_index = cell_index + deltas;
-            const bool inside = Density<F>::inside(regular_voxel_density(voxel_index));
-            if (inside) {
-                case_number += 1 << i;
-            }
+
+    void extract_regular_cell(const RegularCellIndex& cell_index, uint8_t case_number) {
+        const RegularCase& cell_case = REGULAR_CASES[case_number];
+        if (cell_case.vertex_count == 0) {
+            return;
+        }
+        // To optimize, we could also check if the cell is on a border of the block, here
+        // we only need voxels out of the block when such a cell generates vertices, because
+        // these are for vertex normals
+        density_source->load_regular_extended_voxels();
+        const size_t cell_storage = shared_storage.regular_cell_storage(cell_index.x, cell_index.y, cell_index.z);
+        // Reuse directions with a previous cell in the block
+        const uint8_t reachable_directions = (cell_index.x > 0 ? 1 : 0)
+            | (cell_index.y > 0 ? 2 : 0)
+            | (cell_index.z > 0 ? 4 : 0);
+        std::array<size_t, 12> cell_vertices_indices {};
+        for (size_t i = 0; i < cell_case.vertex_count; ++i) {
+            cell_vertices_indices[i] = regular_vertex(cell_index, cell_storage, reachable_directions, cell_case, i);
+        }
+        for (size_t i = 0; i < 3 * static_cast<size_t>(cell_case.triangle_count); ++i) {
+            tri_indices.push_back(cell_vertices_indices[cell_case.triangles[i]]);
         }
-        return case_number;
     }
-    
     void extract_transition_cells() {
-        density_source.load_transition_voxels(transition_sides);
+        density_source->load_transition_voxels(transition_sides);
         
-        for (auto side = 0; side < transition_sides.size(); ++side) {
+        for (size_t side = 0; side < transition_sides.size(); ++side) {
             if(!transition_sides.test(side)) {
                 continue;
             }
-            current_rotation = Rotation::for_side(static_cast<TransitionSide>(side));
-            for (size_t cell_u = 0; cell_u < block.subdivisions; ++cell_u) {
-                for (size_t cell_v = 0; cell_v < block.subdivisions; ++cell_v) {
-                    TransitionCellIndex cell_index = from_transition_side(static_cast<TransitionSide>(side), cell_u, cell_v);
-                    extract_transition_cell(cell_index);
-                }
+            extract_transition_cells_on_side(static_cast<TransitionSide>(side));
+        }
+    }
+
+    void extract_transition_cells_on_side(TransitionSide side) {
+        current_rotation = Rotation::for_side(side);
+        for (size_t cell_u = 0; cell_u < block.subdivisions; ++cell_u) {
+            for (size_t cell_v = 0; cell_v < block.subdivisions; ++cell_v) {
+                TransitionCellIndex cell_index = from_transition_side(side, cell_u, cell_v);
+                extract_transition_cell(cell_index);
             }
         }
+        finish_pending_vertices();
     }
 
     void extract_transition_cell(TransitionCellIndex& cell_index) {
-        int case_number = transition_cell_case(cell_index);
-        unsigned char raw_cell_class = transitionCellClass[case_number];
-        unsigned char cell_class = raw_cell_class & 0x7F;
-        bool invert_triangulation = (raw_cell_class & 0x80) != 0;
-        bool our_invert_triangulation = !invert_triangulation; // We use LowZ as base case so everything is inverted ?
-        const auto& triangulation_info = transitionCellData[cell_class];
-        const auto vertices_data = transitionVertexData[case_number];
+        const size_t case_number = transition_cell_case(cell_index);
+        const TransitionCase& cell_case = TRANSITION_CASES[case_number];
         std::array<size_t, 12> cell_vertices_indices{0};
-        for (int i = 0; i < 12; ++i) {
-            if (i >= triangulation_info.GetVertexCount()) {
-                break;
-            }
-            cell_vertices_indices[i] = transition_vertex(cell_index, TransitionVertexData{.data=vertices_data[i]});
-        }
-        for (int t = 0; t < triangulation_info.GetTriangleCount(); ++t) {
-            int v1_index_in_cell = triangulation_info.vertexIndex[3 * t];
-            int v2_index_in_cell = triangulation_info.vertexIndex[3 * t + 1];
-            int v3_index_in_cell = triangulation_info.vertexIndex[3 * t + 2];
-            size_t global_index_1 = cell_vertices_indices[v1_index_in_cell];
-            size_t global_index_2 = cell_vertices_indices[v2_index_in_cell];
-            size_t global_index_3 = cell_vertices_indices[v3_index_in_cell];
-            if (our_invert_triangulation) {
-                tri_indices.push_back(global_index_1);
-                tri_indices.push_back(global_index_2);
-                tri_indices.push_back(global_index_3);
-            } else {
-                tri_indices.push_back(global_index_3);
-                tri_indices.push_back(global_index_2);
-                tri_indices.push_back(global_index_1);
-            }
+        for (size_t i = 0; i < cell_case.vertex_count; ++i) {
+            cell_vertices_indices[i] = transition_vertex(cell_index, cell_case, i);
+        }
+        for (size_t i = 0; i < 3 * static_cast<size_t>(cell_case.triangle_count); ++i) {
+            tri_indices.push_back(cell_vertices_indices[cell_case.triangles[i]]);
         }
     }
 
@@ -247,7 +637,7 @@ struct Extractor {
         for (const auto& [voxel_delta, contribution] : TRANSITION_HIGH_RES_FACE_CASE_CONTRIBUTIONS) {
             const HighResolutionVoxelIndex voxel_index = cell_index + voxel_delta;
             const auto density = transition_grid_point_density(voxel_index);
-            const bool inside = Density<F>::inside(density);
+            const bool inside = Density<D>::inside(density, threshold);
             if (inside) {
                 case_number += contribution;
             }
@@ -256,83 +646,65 @@ struct Extractor {
     }
 
     D regular_voxel_density(const RegularVoxelIndex& voxel_index) {
-        return density_source.get_density(voxel_index);
+        return density_source->get_density(voxel_index);
     }
 
     D transition_grid_point_density(const HighResolutionVoxelIndex& voxel_index) {
         if (on_regular_grid(voxel_index)) {
             const RegularVoxelIndex regular_index = as_regular_index(voxel_index, current_rotation, block.subdivisions);
-            return density_source.get_density(regular_index);
+            return density_source->get_density(regular_index);
         } else {
-            return density_source.get_transition_density(voxel_index);
+            return density_source->get_transition_density(voxel_index);
         }
     }
 
-    size_t regular_vertex(const RegularCellIndex& cell_index, const RegularVertexData& vd) {
-        const size_t cell_x = cell_index.x;
-        const size_t cell_y = cell_index.y;
-        const size_t cell_z = cell_index.z;
-        if (vd.new_vertex()) {
-            const size_t i = new_regular_vertex(cell_index, vd.voxel_a_index(), vd.voxel_b_index());
-            shared_storage.put_regular(i, cell_x, cell_y, cell_z, vd.reuse_index().index);
+    size_t regular_vertex(const RegularCellIndex& cell_index, size_t cell_storage, uint8_t reachable_directions,
+                          const RegularCase& cell_case, size_t vertex) {
+        const uint8_t reuse_slot = cell_case.reuse_slot[vertex];
+        const uint8_t directions = reuse_slot >> 2;
+        if (directions == 0) {
+            const size_t i = new_regular_vertex(cell_index, cell_case.voxel_a[vertex], cell_case.voxel_b[vertex]);
+            shared_storage.put_regular(i, cell_storage, reuse_slot);
             return i;
+        } else if ((directions & ~reachable_directions) == 0) {
+            return shared_storage.get_regular(cell_storage, reuse_slot);
         } else {
-            const bool previous_vertex_is_accessible =
-                ((vd.reuse_dx() == 0) || (cell_x > 0)) &&
-                ((vd.reuse_dy() == 0) || (cell_y > 0)) &&
-                ((vd.reuse_dz() == 0) || (cell_z > 0));
-            if (previous_vertex_is_accessible) {
-                return shared_storage.get_regular(
-                    static_cast<size_t>(static_cast<size_t>(cell_x) + vd.reuse_dx()),
-                    static_cast<size_t>(static_cast<size_t>(cell_y) + vd.reuse_dy()),
-                    static_cast<size_t>(static_cast<size_t>(cell_z) + vd.reuse_dz()),
-                    vd.reuse_index().index
-                );
-            } else {
-                const size_t i = new_regular_vertex(cell_index, vd.voxel_a_index(), vd.voxel_b_index());
-                return i;
-            }
+            return new_regular_vertex(cell_index, cell_case.voxel_a[vertex], cell_case.voxel_b[vertex]);
         }
     }
 
-    size_t transition_vertex(const TransitionCellIndex& cell_index, const TransitionVertexData& vd) {
-        if (vd.reuse()) {
-            const size_t cell_u = cell_index.cell_u;
-            const size_t cell_v = cell_index.cell_v;
+    size_t transition_vertex(const TransitionCellIndex& cell_index, const TransitionCase& cell_case, size_t vertex) {
+        const uint8_t directions = cell_case.reuse_directions[vertex];
+        const TransitionReuseIndex reuse_index{ cell_case.reuse_index[vertex] };
+        if (directions != 0) {
             const bool previous_vertex_is_accessible =
-                ((vd.reuse_du() == 0) || (cell_u > 0)) &&
-                ((vd.reuse_dv() == 0) || (cell_v > 0));
+                ((directions & 1) == 0 || cell_index.cell_u > 0) && ((directions & 2) == 0 || cell_index.cell_v > 0);
             if (previous_vertex_is_accessible) {
-                const size_t reuse_cell_u = static_cast<size_t>(static_cast<size_t>(cell_u) + vd.reuse_du());
-                const size_t reuse_cell_v = static_cast<size_t>(static_cast<size_t>(cell_v) + vd.reuse_dv());
                 const TransitionCellIndex previous_index = {
                     .side = cell_index.side,
-                    .cell_u = reuse_cell_u,
-                    .cell_v = reuse_cell_v
+                    .cell_u = static_cast<CellCoordinate>(cell_index.cell_u - ((directions & 1) ? 1 : 0)),
+                    .cell_v = static_cast<CellCoordinate>(cell_index.cell_v - ((directions & 2) ? 1 : 0))
                 };
-                return shared_storage.get_transition(previous_index, vd.reuse_index());
+                return shared_storage.get_transition(previous_index, reuse_index);
             } else {
-                const size_t i = new_transition_vertex(cell_index, vd.grid_point_a_index(), vd.grid_point_b_index());
-                return i;
+                return new_transition_vertex(cell_index, cell_case, vertex);
             }
         } else {
-            const size_t i = new_transition_vertex(cell_index, vd.grid_point_a_index(), vd.grid_point_b_index());
-            if (vd.new_reusable()) {
-                shared_storage.put_transition(i, cell_index, vd.reuse_index());
+            const size_t i = new_transition_vertex(cell_index, cell_case, vertex);
+            if (cell_case.reuse_index[vertex] != TRANSITION_NOT_REUSED) {
+                shared_storage.put_transition(i, cell_index, reuse_index);
             }
             return i;
         }
     }
 
-    size_t new_transition_vertex(
-        const TransitionCellIndex& cell_index,
-        const TransitionCellGridPointIndex& grid_point_a_index,
-        const TransitionCellGridPointIndex& grid_point_b_index
-    ) {
-        const auto a = transition_grid_point(cell_index, grid_point_a_index);
-        const auto b = transition_grid_point(cell_index, grid_point_b_index);
-        const size_t i = add_vertex_between(a, b);
-        return i;
+    size_t new_transition_vertex(const TransitionCellIndex& cell_index, const TransitionCase& cell_case, size_t vertex) {
+        const uint8_t low_resolution_ends = cell_case.low_resolution_ends[vertex];
+        const auto a = transition_grid_point(cell_index, (low_resolution_ends & TRANSITION_END_A_LOW_RESOLUTION) != 0,
+                                             cell_case.a_u[vertex], cell_case.a_v[vertex]);
+        const auto b = transition_grid_point(cell_index, (low_resolution_ends & TRANSITION_END_B_LOW_RESOLUTION) != 0,
+                                             cell_case.b_u[vertex], cell_case.b_v[vertex]);
+        return add_vertex_between(a, b);
     }
 
     size_t new_regular_vertex(
@@ -358,7 +730,33 @@ struct Extractor {
         const auto position = regular_grid_point_position(voxel_index);
         const auto gradient = regular_voxel_gradient(voxel_index);
         const D density = regular_voxel_density(voxel_index);
-        return GridPoint<F, D>{.position=position, .gradient=gradient, .density=density};
+        if (with_secondary_positions) {
+            return GridPoint<F, D>{
+                .position=position,
+                .gradient=gradient,
+                .density=density,
+                .secondary_position=regular_grid_point_secondary_position(voxel_index),
+                .border_sides=border_sides_of(voxel_index.x, voxel_index.y, voxel_index.z, block.subdivisions)
+            };
+        }
+        return GridPoint<F, D>{.position=position, .gradient=gradient, .density=density,
+                               .secondary_position=position, .border_sides=0};
+    }
+
+    /**
+    The position the voxel would have if all the block sides it touches were transition sides
+    */
+    Position<F> regular_grid_point_secondary_position(const RegularVoxelIndex& voxel_index) const {
+        F x = block.dims.base[0] +
+            block.dims.size * Coordinate<F>::from_ratio(voxel_index.x, block.subdivisions);
+        F y = block.dims.base[1] +
+            block.dims.size * Coordinate<F>::from_ratio(voxel_index.y, block.subdivisions);
+        F z = block.dims.base[2] +
+            block.dims.size * Coordinate<F>::from_ratio(voxel_index.z, block.subdivisions);
+        auto cell_size = block.dims.size * Coordinate<F>::from_ratio(1, block.subdivisions);
+        _shrink_if_needed<F, D>(x, y, z, voxel_index.x, voxel_index.y, voxel_index.z,
+                                cell_size, block.subdivisions, TransitionSides().set());
+        return Position<F>(x, y, z);
     }
 
     Position<F> regular_grid_point_position(
@@ -396,24 +794,26 @@ struct Extractor {
 
     std::tuple<F, F, F> regular_voxel_gradient(RegularVoxelIndex voxel_index) {
         F xgradient =
-            Density<F>::diff(regular_voxel_density(RegularVoxelIndex{ voxel_index.x + 1, voxel_index.y, voxel_index.z }),
+            Density<D>::diff(regular_voxel_density(RegularVoxelIndex{ voxel_index.x + 1, voxel_index.y, voxel_index.z }),
             regular_voxel_density(RegularVoxelIndex{ voxel_index.x - 1, voxel_index.y, voxel_index.z }));
-        F ygradient = Density<F>::diff(
+        F ygradient = Density<D>::diff(
             regular_voxel_density(RegularVoxelIndex{ voxel_index.x, voxel_index.y + 1, voxel_index.z }),
             regular_voxel_density(RegularVoxelIndex{ voxel_index.x, voxel_index.y - 1, voxel_index.z }));
-        F zgradient = Density<F>::diff(
+        F zgradient = Density<D>::diff(
             regular_voxel_density(RegularVoxelIndex{ voxel_index.x, voxel_index.y, voxel_index.z + 1 })
                 ,regular_voxel_density(RegularVoxelIndex{ voxel_index.x, voxel_index.y, voxel_index.z - 1 }));
         return std::make_tuple(xgradient, ygradient, zgradient);
     }
 
-    GridPoint<F, D> transition_grid_point(const TransitionCellIndex& cell_index, const TransitionCellGridPointIndex& grid_point_index) {
-        auto &tmp = TRANSITION_CELL_GRID_POINTS[grid_point_index.index];
-        if(tmp.type == TransitionCellGridPointType::HighResFace) {
-            return transition_grid_point_on_high_res_face(cell_index, tmp.data.highResFace);
-        }
-        else {
-            return transition_grid_point_on_low_res_face(cell_index, tmp.data.regularFace.u, tmp.data.regularFace.v);
+    /**
+    Grid point of a transition cell, `u` and `v` being in half cells
+    */
+    GridPoint<F, D> transition_grid_point(const TransitionCellIndex& cell_index, bool low_resolution_face,
+                                          uint8_t u, uint8_t v) {
+        if (low_resolution_face) {
+            return transition_grid_point_on_low_res_face(cell_index, u / 2, v / 2);
+        } else {
+            return transition_grid_point_on_high_res_face(cell_index, HighResolutionVoxelDelta({ u, v, 0 }));
         }
     }
 
@@ -432,7 +832,7 @@ struct Extractor {
         auto position = high_res_face_grid_point_position(cell_index, delta);
         auto gradient = high_res_face_grid_point_gradient(voxel_index);
         auto density = high_res_face_grid_point_density(voxel_index);
-        return GridPoint<F, D>{position, gradient, density};
+        return GridPoint<F, D>{position, gradient, density, position, 0};
     }
 
     Position<F> high_res_face_grid_point_position(const TransitionCellIndex& cell_index,
@@ -456,12 +856,12 @@ struct Extractor {
     std::tuple<F, F, F> high_res_face_grid_point_gradient_non_regular(const HighResolutionVoxelIndex& base_voxel_index
     ) {
         auto &rot = current_rotation;
-        auto x_gradient = transition_grid_point_density(base_voxel_index + rot.plus_x_as_uvw)
-                        - transition_grid_point_density(base_voxel_index - rot.plus_x_as_uvw);
-        auto y_gradient = transition_grid_point_density(base_voxel_index + rot.plus_y_as_uvw)
-                        - transition_grid_point_density(base_voxel_index - rot.plus_y_as_uvw);
-        auto z_gradient = transition_grid_point_density(base_voxel_index + rot.plus_z_as_uvw)
-                        - transition_grid_point_density(base_voxel_index - rot.plus_z_as_uvw);
+        F x_gradient = Density<D>::diff(transition_grid_point_density(base_voxel_index + rot.plus_x_as_uvw),
+                                        transition_grid_point_density(base_voxel_index - rot.plus_x_as_uvw));
+        F y_gradient = Density<D>::diff(transition_grid_point_density(base_voxel_index + rot.plus_y_as_uvw),
+                                        transition_grid_point_density(base_voxel_index - rot.plus_y_as_uvw));
+        F z_gradient = Density<D>::diff(transition_grid_point_density(base_voxel_index + rot.plus_z_as_uvw),
+                                        transition_grid_point_density(base_voxel_index - rot.plus_z_as_uvw));
         return {x_gradient, y_gradient, z_gradient};
     }
 
@@ -469,21 +869,86 @@ struct Extractor {
         return transition_grid_point_density(voxel_index);
     }
 
-    size_t add_vertex_between(GridPoint<F, D> point_a, GridPoint<F, D> point_b) {
-        auto interp_toward_b = Density<F>::interp(point_a.density, point_b.density, threshold);
-        auto position = point_a.position.interp_toward(point_b.position, interp_toward_b);
-        auto gradient_x = std::get<0>(point_a.gradient) + interp_toward_b * (std::get<0>(point_b.gradient) - std::get<0>(point_a.gradient));
-        auto gradient_y = std::get<1>(point_a.gradient) + interp_toward_b * (std::get<1>(point_b.gradient) - std::get<1>(point_a.gradient));
-        auto gradient_z = std::get<2>(point_a.gradient) + interp_toward_b * (std::get<2>(point_b.gradient) - std::get<2>(point_a.gradient));
-        auto normal = Density<F>::to_normal(gradient_x, gradient_y, gradient_z);
-        vertices_positions.push_back(position.x);
-        vertices_positions.push_back(position.y);
-        vertices_positions.push_back(position.z);
-        vertices_normals.push_back(std::get<0>(normal));
-        vertices_normals.push_back(std::get<1>(normal));
-        vertices_normals.push_back(std::get<2>(normal));
+    /**
+    Gives the vertex on the edge its index right away. Its position and normal come with the next
+    `finish_pending_vertices`
+    */
+    size_t add_vertex_between(const GridPoint<F, D>& point_a, const GridPoint<F, D>& point_b) {
+        pending_vertices.push(point_a, point_b, with_secondary_positions);
+        if (with_secondary_positions) {
+            vertices_border_sides.push_back(point_a.border_sides | point_b.border_sides);
+        }
         auto index = vertices;
         vertices += 1;
         return index;
     }
+
+    /**
+    Interpolates the pending vertices, in the order of their indices
+    */
+    void finish_pending_vertices() {
+        auto& pending = pending_vertices;
+        const size_t count = pending.size();
+        if (count == 0) {
+            return;
+        }
+        std::vector<float> factors(count);
+        std::array<std::vector<F>, 3> positions;
+        std::array<std::vector<float>, 3> normals;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            positions[axis].resize(count);
+            normals[axis].resize(count);
+        }
+        if constexpr (std::is_same_v<F, float> && std::is_same_v<D, float>) {
+            const EdgeCrossings edges{
+                pending.density_a.data(), pending.density_b.data(),
+                { pending.position_a[0].data(), pending.position_a[1].data(), pending.position_a[2].data() },
+                { pending.position_b[0].data(), pending.position_b[1].data(), pending.position_b[2].data() },
+                { pending.gradient_a[0].data(), pending.gradient_a[1].data(), pending.gradient_a[2].data() },
+                { pending.gradient_b[0].data(), pending.gradient_b[1].data(), pending.gradient_b[2].data() }
+            };
+            const InterpolatedVertices out{
+                factors.data(),
+                { positions[0].data(), positions[1].data(), positions[2].data() },
+                { normals[0].data(), normals[1].data(), normals[2].data() }
+            };
+            interpolate_vertices(edges, count, threshold, fast_normals, out);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                const float t = Density<D>::interp(pending.density_a[i], pending.density_b[i], threshold);
+                F gradient[3];
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    const F a = pending.position_a[axis][i];
+                    positions[axis][i] = a + t * (pending.position_b[axis][i] - a);
+                    const F gradient_a = pending.gradient_a[axis][i];
+                    gradient[axis] = gradient_a + t * (pending.gradient_b[axis][i] - gradient_a);
+                }
+                const auto normal = Density<F>::to_normal(gradient[0], gradient[1], gradient[2]);
+                factors[i] = t;
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    normals[axis][i] = normal[axis];
+                }
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const std::array<F, 3> position{ positions[0][i], positions[1][i], positions[2][i] };
+            const std::array<float, 3> normal{ normals[0][i], normals[1][i], normals[2][i] };
+            vertices_positions.insert(vertices_positions.end(), position.begin(), position.end());
+            vertices_normals.insert(vertices_normals.end(), normal.begin(), normal.end());
+            vertices_bounds.add_position(position);
+            vertices_bounds.add_normal({ normal[0], normal[1], normal[2] });
+            if (with_secondary_positions) {
+                std::array<F, 3> secondary;
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    const F a = pending.secondary_a[axis][i];
+                    secondary[axis] = a + factors[i] * (pending.secondary_b[axis][i] - a);
+                }
+                // Either position may be drawn
+                vertices_bounds.add_position(secondary);
+                vertices_secondary_positions.insert(vertices_secondary_positions.end(),
+                                                    secondary.begin(), secondary.end());
+            }
+        }
+        pending.clear();
+    }
 };
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+// Noise evaluation written once over the lane types of simd.hpp. Instantiated with `ScalarLanes` for single
+// points, and with the SIMD lanes for batches: both give the same bits.
+
+struct FractalSettings {
+    uint32_t seed = 0;
+    float frequency = 1.0f;
+    uint32_t octaves = 5;
+    /// Frequency multiplier between octaves
+    float lacunarity = 2.0f;
+    /// Amplitude multiplier between octaves
+    float gain = 0.5f;
+    /// Ridged noise only: value subtracted from, before squaring
+    float ridge_offset = 1.0f;
+};
+
+template <typename L>
+typename L::Float noise_fade(typename L::Float t) {
+    // 6t^5 - 15t^4 + 10t^3
+    auto inner = L::add(L::mul(t, L::sub(L::mul(t, L::set1(6.0f)), L::set1(15.0f))), L::set1(10.0f));
+    return L::mul(L::mul(L::mul(t, t), t), inner);
+}
+
+template <typename L>
+typename L::Float noise_lerp(typename L::Float t, typename L::Float a, typename L::Float b) {
+    return L::add(a, L::mul(t, L::sub(b, a)));
+}
+
+/**
+Dot product of the offset with one of the 12 gradients of improved Perlin noise, picked by the top hash bits
+*/
+template <typename L>
+typename L::Float noise_gradient(typename L::Int hash, typename L::Float x, typename L::Float y, typename L::Float z) {
+    const auto h = L::template shift_right<28>(hash);
+    const auto zero = L::set1_int(0);
+    const auto u = L::select(L::equal_int(L::and_int(h, L::set1_int(8)), zero), x, y);
+    const auto h_is_12_or_14 = L::equal_int(L::and_int(h, L::set1_int(13)), L::set1_int(12));
+    const auto v_high = L::select(h_is_12_or_14, x, z);
+    const auto v = L::select(L::equal_int(L::and_int(h, L::set1_int(12)), zero), y, v_high);
+    const auto u_sign = L::template shift_left<31>(L::and_int(h, L::set1_int(1)));
+    const auto v_sign = L::template shift_left<30>(L::and_int(h, L::set1_int(2)));
+    return L::add(L::xor_bits(u, u_sign), L::xor_bits(v, v_sign));
+}
+
+template <typename L>
+typename L::Int noise_hash(typename L::Int seed, typename L::Int hx, typename L::Int hy, typename L::Int hz) {
+    auto h = L::xor_int(L::xor_int(seed, hx), L::xor_int(hy, hz));
+    h = L::mul_int(h, L::set1_int(0x27d4eb2du));
+    h = L::xor_int(h, L::template shift_right<15>(h));
+    h = L::mul_int(h, L::set1_int(0x2c1b3c6du));
+    return L::xor_int(h, L::template shift_right<12>(h));
+}
+
+/**
+Gradient noise of unit frequency, roughly within [-1, 1]
+*/
+template <typename L>
+typename L::Float gradient_noise(typename L::Float x, typename L::Float y, typename L::Float z, uint32_t seed) {
+    constexpr uint32_t PRIME_X = 501125321u;
+    constexpr uint32_t PRIME_Y = 1136930381u;
+    constexpr uint32_t PRIME_Z = 1720413743u;
+    const auto ix = L::floor_to_int(x);
+    const auto iy = L::floor_to_int(y);
+    const auto iz = L::floor_to_int(z);
+    const auto fx0 = L::sub(x, L::to_float(ix));
+    const auto fy0 = L::sub(y, L::to_float(iy));
+    const auto fz0 = L::sub(z, L::to_float(iz));
+    const auto one = L::set1(1.0f);
+    const auto fx1 = L::sub(fx0, one);
+    const auto fy1 = L::sub(fy0, one);
+    const auto fz1 = L::sub(fz0, one);
+    const auto hx0 = L::mul_int(ix, L::set1_int(PRIME_X));
+    const auto hy0 = L::mul_int(iy, L::set1_int(PRIME_Y));
+    const auto hz0 = L::mul_int(iz, L::set1_int(PRIME_Z));
+    const auto hx1 = L::add_int(hx0, L::set1_int(PRIME_X));
+    const auto hy1 = L::add_int(hy0, L::set1_int(PRIME_Y));
+    const auto hz1 = L::add_int(hz0, L::set1_int(PRIME_Z));
+    const auto s = L::set1_int(seed);
+
+    const auto g000 = noise_gradient<L>(noise_hash<L>(s, hx0, hy0, hz0), fx0, fy0, fz0);
+    const auto g100 = noise_gradient<L>(noise_hash<L>(s, hx1, hy0, hz0), fx1, fy0, fz0);
+    const auto g010 = noise_gradient<L>(noise_hash<L>(s, hx0, hy1, hz0), fx0, fy1, fz0);
+    const auto g110 = noise_gradient<L>(noise_hash<L>(s, hx1, hy1, hz0), fx1, fy1, fz0);
+    const auto g001 = noise_gradient<L>(noise_hash<L>(s, hx0, hy0, hz1), fx0, fy0, fz1);
+    const auto g101 = noise_gradient<L>(noise_hash<L>(s, hx1, hy0, hz1), fx1, fy0, fz1);
+    const auto g011 = noise_gradient<L>(noise_hash<L>(s, hx0, hy1, hz1), fx0, fy1, fz1);
+    const auto g111 = noise_gradient<L>(noise_hash<L>(s, hx1, hy1, hz1), fx1, fy1, fz1);
+
+    const auto u = noise_fade<L>(fx0);
+    const auto v = noise_fade<L>(fy0);
+    const auto w = noise_fade<L>(fz0);
+    const auto x00 = noise_lerp<L>(u, g000, g100);
+    const auto x10 = noise_lerp<L>(u, g010, g110);
+    const auto x01 = noise_lerp<L>(u, g001, g101);
+    const auto x11 = noise_lerp<L>(u, g011, g111);
+    return noise_lerp<L>(w, noise_lerp<L>(v, x00, x10), noise_lerp<L>(v, x01, x11));
+}
+
+/**
+Simplex noise of unit frequency, roughly within [-1, 1]: gradients at the 4 corners of the simplex holding the
+point, after skewing space so that simplices tile it, each fading out with the distance to its corner
+*/
+template <typename L>
+typename L::Float simplex_noise(typename L::Float x, typename L::Float y, typename L::Float z, uint32_t seed) {
+    constexpr uint32_t PRIME_X = 501125321u;
+    constexpr uint32_t PRIME_Y = 1136930381u;
+    constexpr uint32_t PRIME_Z = 1720413743u;
+    constexpr float SKEW = 1.0f / 3.0f;
+    constexpr float UNSKEW = 1.0f / 6.0f;
+    const auto zero = L::set1(0.0f);
+    const auto one = L::set1(1.0f);
+    const auto skew = L::mul(L::add(L::add(x, y), z), L::set1(SKEW));
+    const auto ix = L::floor_to_int(L::add(x, skew));
+    const auto iy = L::floor_to_int(L::add(y, skew));
+    const auto iz = L::floor_to_int(L::add(z, skew));
+    const auto fx = L::to_float(ix);
+    const auto fy = L::to_float(iy);
+    const auto fz = L::to_float(iz);
+    const auto unskew = L::mul(L::add(L::add(fx, fy), fz), L::set1(UNSKEW));
+    const auto x0 = L::sub(x, L::sub(fx, unskew));
+    const auto y0 = L::sub(y, L::sub(fy, unskew));
+    const auto z0 = L::sub(z, L::sub(fz, unskew));
+
+    // Order of the offsets, as 0 or 1: products are ands, maxima are ors
+    const auto x_ge_y = L::select(L::greater(y0, x0), zero, one);
+    const auto x_ge_z = L::select(L::greater(z0, x0), zero, one);
+    const auto y_ge_z = L::select(L::greater(z0, y0), zero, one);
+    const auto y_gt_x = L::sub(one, x_ge_y);
+    const auto z_gt_x = L::sub(one, x_ge_z);
+    const auto z_gt_y = L::sub(one, y_ge_z);
+    // Second and third corners, one then two steps along the largest offsets
+    const typename L::Float corner_1[3] = { L::mul(x_ge_y, x_ge_z), L::mul(y_gt_x, y_ge_z), L::mul(z_gt_x, z_gt_y) };
+    const typename L::Float corner_2[3] = { L::max(x_ge_y, x_ge_z), L::max(y_gt_x, y_ge_z), L::max(z_gt_x, z_gt_y) };
+
+    const auto hx = L::mul_int(ix, L::set1_int(PRIME_X));
+    const auto hy = L::mul_int(iy, L::set1_int(PRIME_Y));
+    const auto hz = L::mul_int(iz, L::set1_int(PRIME_Z));
+    const auto s = L::set1_int(seed);
+    const auto contribution = [&](typename L::Float cx, typename L::Float cy, typename L::Float cz, float steps) {
+        const auto unskewed = L::set1(steps * UNSKEW);
+        const auto dx = L::add(L::sub(x0, cx), unskewed);
+        const auto dy = L::add(L::sub(y0, cy), unskewed);
+        const auto dz = L::add(L::sub(z0, cz), unskewed);
+        const auto hash = noise_hash<L>(s, L::add_int(hx, L::mul_int(L::floor_to_int(cx), L::set1_int(PRIME_X))),
+                                        L::add_int(hy, L::mul_int(L::floor_to_int(cy), L::set1_int(PRIME_Y))),
+                                        L::add_int(hz, L::mul_int(L::floor_to_int(cz), L::set1_int(PRIME_Z))));
+        const auto squared = L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz));
+        auto falloff = L::max(L::sub(L::set1(0.6f), squared), zero);
+        falloff = L::mul(falloff, falloff);
+        return L::mul(L::mul(falloff, falloff), noise_gradient<L>(hash, dx, dy, dz));
+    };
+    auto sum = contribution(zero, zero, zero, 0.0f);
+    sum = L::add(sum, contribution(corner_1[0], corner_1[1], corner_1[2], 1.0f));
+    sum = L::add(sum, contribution(corner_2[0], corner_2[1], corner_2[2], 2.0f));
+    sum = L::add(sum, contribution(one, one, one, 3.0f));
+    return L::mul(sum, L::set1(32.0f));
+}
+
+/**
+Fractional Brownian motion: sum of octaves of gradient noise
+*/
+template <typename L>
+typename L::Float fractal_noise(typename L::Float x, typename L::Float y, typename L::Float z,
+                                const FractalSettings& settings) {
+    auto sum = L::set1(0.0f);
+    float frequency = settings.frequency;
+    float amplitude = 1.0f;
+    for (uint32_t octave = 0; octave < settings.octaves; ++octave) {
+        const auto f = L::set1(frequency);
+        const auto n = gradient_noise<L>(L::mul(x, f), L::mul(y, f), L::mul(z, f), settings.seed + octave);
+        sum = L::add(sum, L::mul(L::set1(amplitude), n));
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+    }
+    return sum;
+}
+
+/**
+Musgrave's ridged multifractal: octaves of (offset - |noise|)^2, each one weighted by the previous one
+*/
+template <typename L>
+typename L::Float ridged_noise(typename L::Float x, typename L::Float y, typename L::Float z,
+                               const FractalSettings& settings) {
+    auto sum = L::set1(0.0f);
+    auto weight = L::set1(1.0f);
+    float frequency = settings.frequency;
+    float amplitude = 1.0f;
+    for (uint32_t octave = 0; octave < settings.octaves; ++octave) {
+        const auto f = L::set1(frequency);
+        const auto n = gradient_noise<L>(L::mul(x, f), L::mul(y, f), L::mul(z, f), settings.seed + octave);
+        auto ridge = L::sub(L::set1(settings.ridge_offset), L::abs(n));
+        ridge = L::mul(L::mul(ridge, ridge), weight);
+        sum = L::add(sum, L::mul(L::set1(amplitude), ridge));
+        weight = L::min(L::max(L::mul(ridge, L::set1(2.0f)), L::set1(0.0f)), L::set1(1.0f));
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+    }
+    return sum;
+}
+
+enum class NoiseKind {
+    Gradient,
+    Simplex,
+    Fractal,
+    Ridged
+};
+
+template <typename L>
+typename L::Float noise_of_kind(NoiseKind kind, typename L::Float x, typename L::Float y, typename L::Float z,
+                                const FractalSettings& settings) {
+    switch (kind) {
+    case NoiseKind::Gradient: {
+        const auto f = L::set1(settings.frequency);
+        return gradient_noise<L>(L::mul(x, f), L::mul(y, f), L::mul(z, f), settings.seed);
+    }
+    case NoiseKind::Simplex: {
+        const auto f = L::set1(settings.frequency);
+        return simplex_noise<L>(L::mul(x, f), L::mul(y, f), L::mul(z, f), settings.seed);
+    }
+    case NoiseKind::Fractal:
+        return fractal_noise<L>(x, y, z, settings);
+    default:
+        return ridged_noise<L>(x, y, z, settings);
+    }
+}
+
+/**
+Evaluates `count` points, full registers first and the remainder one by one
+*/
+template <typename L>
+void noise_batch(NoiseKind kind, const FractalSettings& settings,
+                 const float* x, const float* y, const float* z, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + L::width <= count; i += L::width) {
+        L::store(out + i, noise_of_kind<L>(kind, L::load(x + i), L::load(y + i), L::load(z + i), settings));
+    }
+    for (; i < count; ++i) {
+        out[i] = noise_of_kind<ScalarLanes>(kind, x[i], y[i], z[i], settings);
+    }
+}
+
+/// Builds of `noise_batch` for the wider instruction sets, each in its own translation unit
+void noise_batch_avx2(NoiseKind kind, const FractalSettings& settings,
+                      const float* x, const float* y, const float* z, float* out, size_t count);
+void noise_batch_avx512(NoiseKind kind, const FractalSettings& settings,
+                        const float* x, const float* y, const float* z, float* out, size_t count);
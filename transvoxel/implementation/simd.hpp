@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// The same small set of operations on a single float and on SSE2 / AVX2 / AVX-512 registers, so that kernels can
+// be written once as templates over the lane type. Multiplications and additions are never fused, so every
+// width gives bitwise identical results.
+
+// Translation units built for different instruction sets (see `cpu_dispatch.hpp`) each get their own lane
+// types, and so their own instantiations of the kernels: the linker cannot swap in one that the CPU lacks. For
+// the same reason the kernels call no inline function of the standard library, which would be emitted as a weak
+// copy shared by every instruction set
+#if defined(__AVX512F__)
+#define TRANSVOXEL_SIMD_NAMESPACE simd_avx512
+#elif defined(__AVX2__)
+#define TRANSVOXEL_SIMD_NAMESPACE simd_avx2
+#elif defined(__SSE2__)
+#define TRANSVOXEL_SIMD_NAMESPACE simd_sse2
+#else
+#define TRANSVOXEL_SIMD_NAMESPACE simd_scalar
+#endif
+
+inline namespace TRANSVOXEL_SIMD_NAMESPACE {
+
+/// Copies `count` floats, in place of `std::copy`
+inline void copy_lanes(const float* from, size_t count, float* to) {
+    for (size_t i = 0; i < count; ++i) {
+        to[i] = from[i];
+    }
+}
+
+struct ScalarLanes {
+    static constexpr size_t width = 1;
+    using Float = float;
+    using Int = uint32_t;
+    using Mask = bool;
+
+    static Float load(const float* p) { return *p; }
+    static void store(float* p, Float v) { *p = v; }
+    static Float set1(float v) { return v; }
+    static Float add(Float a, Float b) { return a + b; }
+    static Float sub(Float a, Float b) { return a - b; }
+    static Float mul(Float a, Float b) { return a * b; }
+    static Float div(Float a, Float b) { return a / b; }
+    static Float sqrt(Float a) { return ::sqrtf(a); }
+    /// Exact here, an estimate of about 12 bits on the SIMD lanes: not bitwise identical across widths
+    static Float rsqrt(Float a) { return 1.0f / ::sqrtf(a); }
+    static Float min(Float a, Float b) { return a < b ? a : b; }
+    static Float max(Float a, Float b) { return a < b ? b : a; }
+    static Float abs(Float a) { return and_bits(a, 0x7fffffffu); }
+    static Mask greater(Float a, Float b) { return a > b; }
+    static Float select(Mask m, Float a, Float b) { return m ? a : b; }
+
+    static Int set1_int(uint32_t v) { return v; }
+    static Int add_int(Int a, Int b) { return a + b; }
+    static Int mul_int(Int a, Int b) { return a * b; }
+    static Int xor_int(Int a, Int b) { return a ^ b; }
+    static Int and_int(Int a, Int b) { return a & b; }
+    template <int bits> static Int shift_right(Int a) { return a >> bits; }
+    template <int bits> static Int shift_left(Int a) { return a << bits; }
+    static Mask equal_int(Int a, Int b) { return a == b; }
+
+    /// Floor, for values within the int32 range
+    static Int floor_to_int(Float a) {
+        int32_t i = static_cast<int32_t>(a);
+        if (static_cast<float>(i) > a) {
+            i -= 1;
+        }
+        return static_cast<Int>(i);
+    }
+    static Float to_float(Int a) { return static_cast<float>(static_cast<int32_t>(a)); }
+    /// Xor of the float bits, used to flip signs
+    static Float xor_bits(Float a, Int bits) {
+        uint32_t a_bits;
+        std::memcpy(&a_bits, &a, sizeof(a_bits));
+        a_bits ^= bits;
+        std::memcpy(&a, &a_bits, sizeof(a_bits));
+        return a;
+    }
+    /// And of the float bits, used to clear signs
+    static Float and_bits(Float a, Int bits) {
+        uint32_t a_bits;
+        std::memcpy(&a_bits, &a, sizeof(a_bits));
+        a_bits &= bits;
+        std::memcpy(&a, &a_bits, sizeof(a_bits));
+        return a;
+    }
+};
+
+#if defined(__SSE2__)
+struct Sse2Lanes {
+    static constexpr size_t width = 4;
+    using Float = __m128;
+    using Int = __m128i;
+    using Mask = __m128i;
+
+    static Float load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+    static Float set1(float v) { return _mm_set1_ps(v); }
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+    static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+    static Float rsqrt(Float a) { return _mm_rsqrt_ps(a); }
+    static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm_max_ps(b, a); }
+    static Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Mask greater(Float a, Float b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+    static Float select(Mask m, Float a, Float b) {
+        const Float mf = _mm_castsi128_ps(m);
+        return _mm_or_ps(_mm_and_ps(mf, a), _mm_andnot_ps(mf, b));
+    }
+
+    static Int set1_int(uint32_t v) { return _mm_set1_epi32(static_cast<int32_t>(v)); }
+    static Int add_int(Int a, Int b) { return _mm_add_epi32(a, b); }
+    static Int mul_int(Int a, Int b) {
+        // No 32 bit multiplication before SSE4.1: multiply even and odd lanes separately
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    static Int xor_int(Int a, Int b) { return _mm_xor_si128(a, b); }
+    static Int and_int(Int a, Int b) { return _mm_and_si128(a, b); }
+    template <int bits> static Int shift_right(Int a) { return _mm_srli_epi32(a, bits); }
+    template <int bits> static Int shift_left(Int a) { return _mm_slli_epi32(a, bits); }
+    static Mask equal_int(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+
+    static Int floor_to_int(Float a) {
+        const __m128i truncated = _mm_cvttps_epi32(a);
+        // Truncation rounded negative values up: the comparison mask is -1 there
+        const __m128i rounded_up = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), a));
+        return _mm_add_epi32(truncated, rounded_up);
+    }
+    static Float to_float(Int a) { return _mm_cvtepi32_ps(a); }
+    static Float xor_bits(Float a, Int bits) { return _mm_xor_ps(a, _mm_castsi128_ps(bits)); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct Avx2Lanes {
+    static constexpr size_t width = 8;
+    using Float = __m256;
+    using Int = __m256i;
+    using Mask = __m256i;
+
+    static Float load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+    static Float set1(float v) { return _mm256_set1_ps(v); }
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+    static Float rsqrt(Float a) { return _mm256_rsqrt_ps(a); }
+    static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm256_max_ps(b, a); }
+    static Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Mask greater(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+    static Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(m)); }
+
+    static Int set1_int(uint32_t v) { return _mm256_set1_epi32(static_cast<int32_t>(v)); }
+    static Int add_int(Int a, Int b) { return _mm256_add_epi32(a, b); }
+    static Int mul_int(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+    static Int xor_int(Int a, Int b) { return _mm256_xor_si256(a, b); }
+    static Int and_int(Int a, Int b) { return _mm256_and_si256(a, b); }
+    template <int bits> static Int shift_right(Int a) { return _mm256_srli_epi32(a, bits); }
+    template <int bits> static Int shift_left(Int a) { return _mm256_slli_epi32(a, bits); }
+    static Mask equal_int(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+
+    static Int floor_to_int(Float a) { return _mm256_cvttps_epi32(_mm256_floor_ps(a)); }
+    static Float to_float(Int a) { return _mm256_cvtepi32_ps(a); }
+    static Float xor_bits(Float a, Int bits) { return _mm256_xor_ps(a, _mm256_castsi256_ps(bits)); }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct Avx512Lanes {
+    static constexpr size_t width = 16;
+    using Float = __m512;
+    using Int = __m512i;
+    using Mask = __mmask16;
+
+    static Float load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, Float v) { _mm512_storeu_ps(p, v); }
+    static Float set1(float v) { return _mm512_set1_ps(v); }
+    static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+    static Float sqrt(Float a) { return _mm512_sqrt_ps(a); }
+    /// 14 bits here
+    static Float rsqrt(Float a) { return _mm512_rsqrt14_ps(a); }
+    static Float min(Float a, Float b) { return _mm512_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm512_max_ps(b, a); }
+    static Float abs(Float a) { return _mm512_abs_ps(a); }
+    static Mask greater(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Float select(Mask m, Float a, Float b) { return _mm512_mask_blend_ps(m, b, a); }
+
+    static Int set1_int(uint32_t v) { return _mm512_set1_epi32(static_cast<int32_t>(v)); }
+    static Int add_int(Int a, Int b) { return _mm512_add_epi32(a, b); }
+    static Int mul_int(Int a, Int b) { return _mm512_mullo_epi32(a, b); }
+    static Int xor_int(Int a, Int b) { return _mm512_xor_si512(a, b); }
+    static Int and_int(Int a, Int b) { return _mm512_and_si512(a, b); }
+    template <int bits> static Int shift_right(Int a) { return _mm512_srli_epi32(a, bits); }
+    template <int bits> static Int shift_left(Int a) { return _mm512_slli_epi32(a, bits); }
+    static Mask equal_int(Int a, Int b) { return _mm512_cmpeq_epi32_mask(a, b); }
+
+    static Int floor_to_int(Float a) {
+        return _mm512_cvttps_epi32(_mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+    }
+    static Float to_float(Int a) { return _mm512_cvtepi32_ps(a); }
+    static Float xor_bits(Float a, Int bits) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), bits));
+    }
+};
+#endif
+
+}
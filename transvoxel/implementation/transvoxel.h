@@ -80,7 +80,7 @@ struct TransitionCellData
 // just with different vertex locations. We combined those classes for this table so
 // that the class index ranges from 0 to 15.
 #define NUM_REGULAR_CELL_CLASSES 256
-const unsigned char regularCellClass[256] =
+constexpr unsigned char regularCellClass[256] =
 {
 	0x00, 0x01, 0x01, 0x03, 0x01, 0x03, 0x02, 0x04, 0x01, 0x02, 0x03, 0x04, 0x03, 0x04, 0x04, 0x03,
 	0x01, 0x03, 0x02, 0x04, 0x02, 0x04, 0x06, 0x0C, 0x02, 0x05, 0x05, 0x0B, 0x05, 0x0A, 0x07, 0x04,
@@ -104,7 +104,7 @@ const unsigned char regularCellClass[256] =
 // The regularCellData table holds the triangulation data for all 16 distinct classes to
 // which a case can be mapped by the regularCellClass table.
 #define NUM_REGULAR_CELL_DATA 16
-const RegularCellData regularCellData[16] =
+constexpr RegularCellData regularCellData[16] =
 {
 	{0x00, {}},
 	{0x31, {0, 1, 2}},
@@ -132,7 +132,7 @@ const RegularCellData regularCellData[16] =
 // as numbered in Figure 3.7. The high byte contains the vertex reuse data shown in Figure 3.8.
 #define NUM_REGULAR_VERTEX_DATA 256
 #define VERTEX_DATA_LENGTH 12
-const unsigned short regularVertexData[256][12] =
+constexpr unsigned short regularVertexData[256][12] =
 {
 	{},
 	{0x6201, 0x5102, 0x3304},
@@ -400,7 +400,7 @@ const unsigned short regularVertexData[256][12] =
 // The high bit is set in the cases for which the inverse state of the voxel data maps to
 // the equivalence class, meaning that the winding order of each triangle should be reversed.
 #define NUM_TRANSITION_CELL_CLASSES 512
-const unsigned char transitionCellClass[512] =
+constexpr unsigned char transitionCellClass[512] =
 {
 	0x00, 0x01, 0x02, 0x84, 0x01, 0x05, 0x04, 0x04, 0x02, 0x87, 0x09, 0x8C, 0x84, 0x0B, 0x05, 0x05,
 	0x01, 0x08, 0x07, 0x8D, 0x05, 0x0F, 0x8B, 0x0B, 0x04, 0x0D, 0x0C, 0x1C, 0x04, 0x8B, 0x85, 0x85,
@@ -441,7 +441,7 @@ const unsigned char transitionCellClass[512] =
 // which a case can be mapped by the transitionCellClass table. The class index should be ANDed
 // with 0x7F before using it to look up triangulation data in this table.
 #define NUM_TRANSITION_CELL_DATA 56
-const TransitionCellData transitionCellData[56] =
+constexpr TransitionCellData transitionCellData[56] =
 {
 	{0x00, {}},
 	{0x42, {0, 1, 3, 1, 2, 3}},
@@ -505,7 +505,7 @@ const TransitionCellData transitionCellData[56] =
 // The transitionCornerData table contains the transition cell corner reuse data
 // shown in Figure 4.18.
 
-const unsigned char transitionCornerData[13] =
+constexpr unsigned char transitionCornerData[13] =
 {
 	0x30, 0x21, 0x20, 0x12, 0x40, 0x82, 0x10, 0x81, 0x80, 0x37, 0x27, 0x17, 0x87
 };
@@ -517,7 +517,7 @@ const unsigned char transitionCornerData[13] =
 // contains the indexes for the two endpoints of the edge on which the vertex lies, as numbered
 // in Figure 4.16. The high byte contains the vertex reuse data shown in Figure 4.17.
 
-const unsigned short transitionVertexData[512][12] =
+constexpr unsigned short transitionVertexData[512][12] =
 {
 	{},
 	{0x2301, 0x1503, 0x199B, 0x289A},
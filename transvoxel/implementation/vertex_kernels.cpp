@@ -0,0 +1,30 @@
+#include "vertex_kernels.hpp"
+#include "cpu_dispatch.hpp"
+
+namespace {
+
+void interpolate_vertices_baseline(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                                   const InterpolatedVertices& out) {
+#if defined(__AVX512F__)
+    interpolate_vertices_batch<Avx512Lanes>(edges, count, threshold, fast_normals, out);
+#elif defined(__AVX2__)
+    interpolate_vertices_batch<Avx2Lanes>(edges, count, threshold, fast_normals, out);
+#elif defined(__SSE2__)
+    interpolate_vertices_batch<Sse2Lanes>(edges, count, threshold, fast_normals, out);
+#else
+    interpolate_vertices_batch<ScalarLanes>(edges, count, threshold, fast_normals, out);
+#endif
+}
+
+}
+
+void interpolate_vertices(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                          const InterpolatedVertices& out) {
+#if defined(TRANSVOXEL_RUNTIME_DISPATCH)
+    static const auto kernel = select_kernel(&interpolate_vertices_baseline, &interpolate_vertices_avx2,
+                                             &interpolate_vertices_avx512);
+    kernel(edges, count, threshold, fast_normals, out);
+#else
+    interpolate_vertices_baseline(edges, count, threshold, fast_normals, out);
+#endif
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+// Vertices of edge crossings finished by batches: interpolation factor toward the second end, position, and
+// normal from the interpolated gradient. Same operations as `Density<float>::interp` and `to_normal`, so the
+// precise mode gives the same bits as one vertex at a time.
+
+/**
+Ends of the crossed edges, in structure of arrays
+*/
+struct EdgeCrossings {
+    const float* density_a;
+    const float* density_b;
+    const float* position_a[3];
+    const float* position_b[3];
+    const float* gradient_a[3];
+    const float* gradient_b[3];
+};
+
+struct InterpolatedVertices {
+    float* factor;
+    float* position[3];
+    float* normal[3];
+};
+
+template <typename L>
+void interpolate_vertices_at(const EdgeCrossings& edges, size_t i, float threshold, bool fast_normals,
+                             const InterpolatedVertices& out) {
+    const auto epsilon = L::set1(0x1p-23f);
+    const auto a = L::load(edges.density_a + i);
+    const auto b = L::load(edges.density_b + i);
+    const auto difference = L::sub(b, a);
+    const auto t = L::select(L::greater(L::abs(difference), epsilon),
+                             L::div(L::sub(L::set1(threshold), a), difference), L::set1(0.5f));
+    L::store(out.factor + i, t);
+    typename L::Float gradient[3];
+    for (size_t axis = 0; axis < 3; ++axis) {
+        const auto position_a = L::load(edges.position_a[axis] + i);
+        const auto position_b = L::load(edges.position_b[axis] + i);
+        L::store(out.position[axis] + i, L::add(position_a, L::mul(t, L::sub(position_b, position_a))));
+        const auto gradient_a = L::load(edges.gradient_a[axis] + i);
+        const auto gradient_b = L::load(edges.gradient_b[axis] + i);
+        gradient[axis] = L::add(gradient_a, L::mul(t, L::sub(gradient_b, gradient_a)));
+    }
+    const auto squared_norm = L::add(L::add(L::mul(gradient[0], gradient[0]), L::mul(gradient[1], gradient[1])),
+                                     L::mul(gradient[2], gradient[2]));
+    const auto sign = L::set1_int(0x80000000u);
+    const auto zero = L::set1(0.0f);
+    if (fast_normals) {
+        // One Newton step on the estimate: y * (1.5 - 0.5 * x * y^2)
+        auto inverse = L::rsqrt(squared_norm);
+        const auto half_squared = L::mul(L::set1(0.5f), squared_norm);
+        inverse = L::mul(inverse, L::sub(L::set1(1.5f), L::mul(half_squared, L::mul(inverse, inverse))));
+        const auto valid = L::greater(squared_norm, L::mul(epsilon, epsilon));
+        for (size_t axis = 0; axis < 3; ++axis) {
+            L::store(out.normal[axis] + i, L::select(valid, L::mul(L::xor_bits(gradient[axis], sign), inverse), zero));
+        }
+    } else {
+        const auto norm = L::sqrt(squared_norm);
+        const auto valid = L::greater(norm, epsilon);
+        for (size_t axis = 0; axis < 3; ++axis) {
+            L::store(out.normal[axis] + i, L::select(valid, L::div(L::xor_bits(gradient[axis], sign), norm), zero));
+        }
+    }
+}
+
+/**
+Finishes `count` vertices, full registers first, then the remainder through one padded register so that every
+vertex goes through the same instructions
+*/
+template <typename L>
+void interpolate_vertices_batch(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                                const InterpolatedVertices& out) {
+    size_t i = 0;
+    for (; i + L::width <= count; i += L::width) {
+        interpolate_vertices_at<L>(edges, i, threshold, fast_normals, out);
+    }
+    const size_t remainder = count - i;
+    if (remainder == 0) {
+        return;
+    }
+    // Padding lanes get a regular edge, and their results are dropped
+    constexpr size_t W = L::width;
+    float in[14][W] = {};
+    float result[7][W] = {};
+    for (size_t lane = 0; lane < W; ++lane) {
+        in[1][lane] = 1.0f;
+    }
+    copy_lanes(edges.density_a + i, remainder, in[0]);
+    copy_lanes(edges.density_b + i, remainder, in[1]);
+    EdgeCrossings padded{ in[0], in[1], {}, {}, {}, {} };
+    InterpolatedVertices padded_out{ result[0], {}, {} };
+    for (size_t axis = 0; axis < 3; ++axis) {
+        copy_lanes(edges.position_a[axis] + i, remainder, in[2 + axis]);
+        copy_lanes(edges.position_b[axis] + i, remainder, in[5 + axis]);
+        copy_lanes(edges.gradient_a[axis] + i, remainder, in[8 + axis]);
+        copy_lanes(edges.gradient_b[axis] + i, remainder, in[11 + axis]);
+        padded.position_a[axis] = in[2 + axis];
+        padded.position_b[axis] = in[5 + axis];
+        padded.gradient_a[axis] = in[8 + axis];
+        padded.gradient_b[axis] = in[11 + axis];
+        padded_out.position[axis] = result[1 + axis];
+        padded_out.normal[axis] = result[4 + axis];
+    }
+    interpolate_vertices_at<L>(padded, 0, threshold, fast_normals, padded_out);
+    copy_lanes(result[0], remainder, out.factor + i);
+    for (size_t axis = 0; axis < 3; ++axis) {
+        copy_lanes(result[1 + axis], remainder, out.position[axis] + i);
+        copy_lanes(result[4 + axis], remainder, out.normal[axis] + i);
+    }
+}
+
+/**
+Finishes `count` vertices with the widest instruction set available. `fast_normals` normalizes gradients with a
+reciprocal square root estimate and a Newton step, within about 1e-6 of the division
+*/
+void interpolate_vertices(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                          const InterpolatedVertices& out);
+
+/// Builds of `interpolate_vertices_batch` for the wider instruction sets, each in its own translation unit
+void interpolate_vertices_avx2(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                               const InterpolatedVertices& out);
+void interpolate_vertices_avx512(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                                 const InterpolatedVertices& out);
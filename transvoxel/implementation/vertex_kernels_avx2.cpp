@@ -0,0 +1,10 @@
+#include "vertex_kernels.hpp"
+
+#if !defined(__AVX2__)
+#error "Build with -mavx2"
+#endif
+
+void interpolate_vertices_avx2(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                               const InterpolatedVertices& out) {
+    interpolate_vertices_batch<Avx2Lanes>(edges, count, threshold, fast_normals, out);
+}
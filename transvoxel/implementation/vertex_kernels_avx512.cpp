@@ -0,0 +1,10 @@
+#include "vertex_kernels.hpp"
+
+#if !defined(__AVX512F__)
+#error "Build with -mavx512f"
+#endif
+
+void interpolate_vertices_avx512(const EdgeCrossings& edges, size_t count, float threshold, bool fast_normals,
+                                 const InterpolatedVertices& out) {
+    interpolate_vertices_batch<Avx512Lanes>(edges, count, threshold, fast_normals, out);
+}
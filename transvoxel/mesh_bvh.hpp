@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "structs.hpp"
+
+/**
+Node of a flattened BVH, in depth first order: the first child of an inner node is the next node
+*/
+template <typename F>
+struct MeshBvhNode {
+    std::array<F, 3> low;
+    std::array<F, 3> high;
+    /// Inner node: index of the second child. Leaf: first of its entries in `MeshBvh::triangles`
+    uint32_t offset;
+    /// Number of triangles of a leaf, 0 for inner nodes
+    uint32_t count;
+
+    bool is_leaf() const {
+        return count != 0;
+    }
+};
+
+template <typename F>
+struct MeshRayHit {
+    uint32_t triangle;
+    /// Along the ray, in multiples of the direction given
+    F distance;
+    /// Barycentric coordinates of the hit, relative to the second and third vertices of the triangle
+    F u;
+    F v;
+};
+
+/**
+Bounding volume hierarchy over the triangles of a mesh, for ray and sphere queries. It does not hold the mesh:
+queries take the mesh it was built from, which must not have changed since
+*/
+template <typename F>
+class MeshBvh {
+public:
+    static constexpr size_t MAX_LEAF_TRIANGLES = 4;
+    /// Levels below the root. Median splits halve the triangles until a leaf holds them, and triangles are indexed
+    /// with 32 bits
+    static constexpr size_t MAX_DEPTH = 30;
+    static_assert((uint64_t(1) << (32 - MAX_DEPTH)) <= MAX_LEAF_TRIANGLES);
+    /// Queries stack the other child of each inner node they go through, and both children of the deepest one
+    static constexpr size_t QUERY_STACK_SIZE = MAX_DEPTH + 2;
+
+    MeshBvh(const Mesh<F>& mesh) {
+        const size_t triangle_count = mesh.num_tris();
+        if (triangle_count == 0) {
+            return;
+        }
+        assert(triangle_count <= std::numeric_limits<uint32_t>::max());
+        std::vector<std::array<F, 3>> centroids(triangle_count);
+        triangles.resize(triangle_count);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            triangles[t] = static_cast<uint32_t>(t);
+            for (size_t c = 0; c < 3; ++c) {
+                centroids[t][c] = (vertex(mesh, t, 0)[c] + vertex(mesh, t, 1)[c] + vertex(mesh, t, 2)[c]) / 3;
+            }
+        }
+        nodes.reserve(2 * triangle_count / MAX_LEAF_TRIANGLES + 1);
+        build(mesh, centroids, 0, triangle_count, 0);
+    }
+
+    /**
+    Nearest triangle hit by the ray within `max_distance` (in multiples of `direction`), from either side
+    */
+    std::optional<MeshRayHit<F>> raycast(const Mesh<F>& mesh, const std::array<F, 3>& origin,
+                                         const std::array<F, 3>& direction,
+                                         F max_distance = std::numeric_limits<F>::max()) const {
+        std::optional<MeshRayHit<F>> nearest;
+        if (nodes.empty()) {
+            return nearest;
+        }
+        std::array<F, 3> inverse;
+        for (size_t c = 0; c < 3; ++c) {
+            inverse[c] = F(1) / direction[c];
+        }
+        uint32_t stack[QUERY_STACK_SIZE];
+        size_t stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0) {
+            const MeshBvhNode<F>& node = nodes[stack[--stack_size]];
+            if (!ray_hits_box(node, origin, inverse, max_distance)) {
+                continue;
+            }
+            if (node.is_leaf()) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                    auto hit = ray_triangle(mesh, triangles[i], origin, direction);
+                    if (hit && hit->distance <= max_distance) {
+                        max_distance = hit->distance;
+                        nearest = hit;
+                    }
+                }
+            } else {
+                assert(stack_size + 2 <= QUERY_STACK_SIZE);
+                // Push the farther child first, to visit the nearer one first and shorten the ray early
+                const uint32_t first = static_cast<uint32_t>(&node - nodes.data()) + 1;
+                const uint32_t second = node.offset;
+                if (box_entry(nodes[first], origin, inverse) < box_entry(nodes[second], origin, inverse)) {
+                    stack[stack_size++] = second;
+                    stack[stack_size++] = first;
+                } else {
+                    stack[stack_size++] = first;
+                    stack[stack_size++] = second;
+                }
+            }
+        }
+        return nearest;
+    }
+
+    /**
+    Appends to `result` the triangles touching the sphere
+    */
+    void triangles_in_sphere(const Mesh<F>& mesh, const std::array<F, 3>& center, F radius,
+                             std::vector<uint32_t>& result) const {
+        if (nodes.empty()) {
+            return;
+        }
+        const F squared_radius = radius * radius;
+        uint32_t stack[QUERY_STACK_SIZE];
+        size_t stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0) {
+            const uint32_t index = stack[--stack_size];
+            const MeshBvhNode<F>& node = nodes[index];
+            F squared_distance = 0;
+            for (size_t c = 0; c < 3; ++c) {
+                const F d = std::max({ node.low[c] - center[c], center[c] - node.high[c], F(0) });
+                squared_distance += d * d;
+            }
+            if (squared_distance > squared_radius) {
+                continue;
+            }
+            if (node.is_leaf()) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                    if (squared_distance_to_triangle(mesh, triangles[i], center) <= squared_radius) {
+                        result.push_back(triangles[i]);
+                    }
+                }
+            } else {
+                assert(stack_size + 2 <= QUERY_STACK_SIZE);
+                stack[stack_size++] = node.offset;
+                stack[stack_size++] = index + 1;
+            }
+        }
+    }
+
+    size_t memory_size() const {
+        return sizeof(*this) + nodes.capacity() * sizeof(MeshBvhNode<F>) + triangles.capacity() * sizeof(uint32_t);
+    }
+
+    std::vector<MeshBvhNode<F>> nodes;
+    /// Triangle indices, grouped by leaf
+    std::vector<uint32_t> triangles;
+
+private:
+    static const F* vertex(const Mesh<F>& mesh, size_t triangle, size_t corner) {
+        return &mesh.positions[3 * mesh.triangle_indices[3 * triangle + corner]];
+    }
+
+    /**
+    Builds the node of triangles [begin, end), `depth` levels below the root, splitting at the median centroid
+    along the widest axis. Depth stays within `MAX_DEPTH`, so within the query stacks
+    */
+    void build(const Mesh<F>& mesh, const std::vector<std::array<F, 3>>& centroids, size_t begin, size_t end,
+               size_t depth) {
+        assert(depth <= MAX_DEPTH);
+        const size_t index = nodes.size();
+        nodes.push_back(MeshBvhNode<F>{});
+        MeshBvhNode<F> node;
+        node.low.fill(std::numeric_limits<F>::max());
+        node.high.fill(std::numeric_limits<F>::lowest());
+        std::array<F, 3> centroid_low = node.low;
+        std::array<F, 3> centroid_high = node.high;
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t corner = 0; corner < 3; ++corner) {
+                const F* p = vertex(mesh, triangles[i], corner);
+                for (size_t c = 0; c < 3; ++c) {
+                    node.low[c] = std::min(node.low[c], p[c]);
+                    node.high[c] = std::max(node.high[c], p[c]);
+                }
+            }
+            for (size_t c = 0; c < 3; ++c) {
+                centroid_low[c] = std::min(centroid_low[c], centroids[triangles[i]][c]);
+                centroid_high[c] = std::max(centroid_high[c], centroids[triangles[i]][c]);
+            }
+        }
+        if (end - begin <= MAX_LEAF_TRIANGLES) {
+            node.offset = static_cast<uint32_t>(begin);
+            node.count = static_cast<uint32_t>(end - begin);
+            nodes[index] = node;
+            return;
+        }
+        size_t axis = 0;
+        for (size_t c = 1; c < 3; ++c) {
+            if (centroid_high[c] - centroid_low[c] > centroid_high[axis] - centroid_low[axis]) {
+                axis = c;
+            }
+        }
+        const size_t middle = begin + (end - begin) / 2;
+        std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        build(mesh, centroids, begin, middle, depth + 1);
+        node.offset = static_cast<uint32_t>(nodes.size());
+        node.count = 0;
+        build(mesh, centroids, middle, end, depth + 1);
+        nodes[index] = node;
+    }
+
+    static F box_entry(const MeshBvhNode<F>& node, const std::array<F, 3>& origin, const std::array<F, 3>& inverse) {
+        F entry = std::numeric_limits<F>::lowest();
+        for (size_t c = 0; c < 3; ++c) {
+            const F t0 = (node.low[c] - origin[c]) * inverse[c];
+            const F t1 = (node.high[c] - origin[c]) * inverse[c];
+            entry = std::max(entry, std::min(t0, t1));
+        }
+        return entry;
+    }
+
+    static bool ray_hits_box(const MeshBvhNode<F>& node, const std::array<F, 3>& origin,
+                             const std::array<F, 3>& inverse, F max_distance) {
+        F entry = 0;
+        F exit = max_distance;
+        for (size_t c = 0; c < 3; ++c) {
+            F t0 = (node.low[c] - origin[c]) * inverse[c];
+            F t1 = (node.high[c] - origin[c]) * inverse[c];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            // NaN (ray in the plane of a face, parallel to it) leaves the interval alone
+            entry = t0 > entry ? t0 : entry;
+            exit = t1 < exit ? t1 : exit;
+        }
+        return entry <= exit;
+    }
+
+    /**
+    Möller-Trumbore
+    */
+    static std::optional<MeshRayHit<F>> ray_triangle(const Mesh<F>& mesh, uint32_t triangle,
+                                                     const std::array<F, 3>& origin,
+                                                     const std::array<F, 3>& direction) {
+        const F* a = vertex(mesh, triangle, 0);
+        const F* b = vertex(mesh, triangle, 1);
+        const F* c = vertex(mesh, triangle, 2);
+        const F e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const F e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        const F p[3] = { direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2],
+                         direction[0] * e2[1] - direction[1] * e2[0] };
+        const F determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if (std::abs(determinant) <= std::numeric_limits<F>::min()) {
+            return std::nullopt;
+        }
+        const F inverse_determinant = F(1) / determinant;
+        const F s[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+        const F u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse_determinant;
+        if (u < 0 || u > 1) {
+            return std::nullopt;
+        }
+        const F q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+        const F v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse_determinant;
+        if (v < 0 || u + v > 1) {
+            return std::nullopt;
+        }
+        const F distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse_determinant;
+        if (distance < 0) {
+            return std::nullopt;
+        }
+        return MeshRayHit<F>{ triangle, distance, u, v };
+    }
+
+    /**
+    Squared distance from `p` to the closest point of the triangle (Ericson, Real-Time Collision Detection 5.1.5)
+    */
+    static F squared_distance_to_triangle(const Mesh<F>& mesh, uint32_t triangle, const std::array<F, 3>& p) {
+        const F* a = vertex(mesh, triangle, 0);
+        const F* b = vertex(mesh, triangle, 1);
+        const F* c = vertex(mesh, triangle, 2);
+        auto dot = [](const F* x, const F* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+        const F ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const F ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        const F normal[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2],
+                              ab[0] * ac[1] - ab[1] * ac[0] };
+        if (dot(normal, normal) <= 0) {
+            // Degenerate triangle, which the extraction does produce: nearest of its edges
+            return std::min({ squared_distance_to_segment(a, b, p), squared_distance_to_segment(b, c, p),
+                              squared_distance_to_segment(c, a, p) });
+        }
+        const F ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+        std::array<F, 3> closest;
+        auto at = [&](F v, F w) {
+            for (size_t i = 0; i < 3; ++i) {
+                closest[i] = a[i] + v * ab[i] + w * ac[i];
+            }
+        };
+        const F d1 = dot(ab, ap);
+        const F d2 = dot(ac, ap);
+        const F bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+        const F d3 = dot(ab, bp);
+        const F d4 = dot(ac, bp);
+        const F cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+        const F d5 = dot(ab, cp);
+        const F d6 = dot(ac, cp);
+        const F va = d3 * d6 - d5 * d4;
+        const F vb = d5 * d2 - d1 * d6;
+        const F vc = d1 * d4 - d3 * d2;
+        if (d1 <= 0 && d2 <= 0) {
+            at(0, 0);
+        } else if (d3 >= 0 && d4 <= d3) {
+            at(1, 0);
+        } else if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+            at(d1 / (d1 - d3), 0);
+        } else if (d6 >= 0 && d5 <= d6) {
+            at(0, 1);
+        } else if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+            at(0, d2 / (d2 - d6));
+        } else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+            const F w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            at(1 - w, w);
+        } else {
+            const F denominator = F(1) / (va + vb + vc);
+            at(vb * denominator, vc * denominator);
+        }
+        F squared = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            squared += (p[i] - closest[i]) * (p[i] - closest[i]);
+        }
+        return squared;
+    }
+
+    static F squared_distance_to_segment(const F* a, const F* b, const std::array<F, 3>& p) {
+        const F ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const F length = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+        F t = 0;
+        if (length > 0) {
+            t = ((p[0] - a[0]) * ab[0] + (p[1] - a[1]) * ab[1] + (p[2] - a[2]) * ab[2]) / length;
+            t = std::clamp(t, F(0), F(1));
+        }
+        F squared = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            const F d = p[i] - (a[i] + t * ab[i]);
+            squared += d * d;
+        }
+        return squared;
+    }
+};
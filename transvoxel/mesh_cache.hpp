@@ -0,0 +1,202 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "extraction.hpp"
+
+/**
+Everything an extraction result depends on. `field_version` is bumped by the caller whenever the field changes.
+Of the extraction options, only those that change the mesh are part of the key: the executor, cancellation and
+adaptive sampling do not
+*/
+template <typename F, typename D>
+struct MeshCacheKey {
+    std::array<F, 3> base;
+    F size;
+    size_t subdivisions;
+    unsigned long transition_sides;
+    D threshold;
+    uint64_t field_version;
+    bool optimize_for_rendering;
+    bool build_meshlets;
+    bool build_bvh;
+    bool fast_normals;
+    DensityCacheLayout cache_layout;
+
+    MeshCacheKey(const Block<F>& block, D threshold, TransitionSides transition_sides, uint64_t field_version,
+                 const ExtractionOptions& options = {})
+        : base(block.dims.base),
+          size(block.dims.size),
+          subdivisions(block.subdivisions),
+          transition_sides(transition_sides.to_ulong()),
+          threshold(threshold),
+          field_version(field_version),
+          optimize_for_rendering(options.optimize_for_rendering),
+          build_meshlets(options.build_meshlets),
+          build_bvh(options.build_bvh),
+          fast_normals(options.fast_normals),
+          cache_layout(options.cache_layout) {}
+
+    bool operator==(const MeshCacheKey& other) const = default;
+};
+
+template <typename F, typename D>
+struct MeshCacheKeyHash {
+    size_t operator()(const MeshCacheKey<F, D>& key) const {
+        size_t h = std::hash<uint64_t>()(key.field_version);
+        auto combine = [&h](size_t value) {
+            h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        };
+        for (const F& coordinate : key.base) {
+            combine(std::hash<F>()(coordinate));
+        }
+        combine(std::hash<F>()(key.size));
+        combine(key.subdivisions);
+        combine(key.transition_sides);
+        // Through double, as there is no std::hash for half floats
+        combine(std::hash<double>()(static_cast<double>(key.threshold)));
+        combine(static_cast<size_t>(key.optimize_for_rendering) | static_cast<size_t>(key.build_meshlets) << 1 |
+                static_cast<size_t>(key.build_bvh) << 2 | static_cast<size_t>(key.fast_normals) << 3 |
+                static_cast<size_t>(key.cache_layout) << 4);
+        return h;
+    }
+};
+
+struct MeshCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+
+    double hit_rate() const {
+        const size_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+/**
+Extraction results kept in memory under a byte budget, least recently used ones being evicted first.
+Safe to share between threads
+*/
+template <typename F, typename D>
+class MeshCache {
+public:
+    using Key = MeshCacheKey<F, D>;
+
+    MeshCache(size_t byte_budget) : byte_budget(byte_budget) {}
+
+    /**
+    Returns null on a miss. A hit makes the entry the most recently used
+    */
+    std::shared_ptr<const Mesh<F>> find(const Key& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            ++statistics.misses;
+            return nullptr;
+        }
+        ++statistics.hits;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->mesh;
+    }
+
+    /**
+    Meshes bigger than the whole budget are not kept
+    */
+    void insert(const Key& key, std::shared_ptr<const Mesh<F>> mesh) {
+        const size_t bytes = mesh->memory_size();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            remove(it->second);
+        }
+        if (bytes > byte_budget) {
+            return;
+        }
+        while (statistics.bytes + bytes > byte_budget) {
+            remove(std::prev(entries.end()));
+            ++statistics.evictions;
+        }
+        entries.push_front(Entry{ key, std::move(mesh), bytes });
+        index.emplace(key, entries.begin());
+        statistics.bytes += bytes;
+        statistics.entries = entries.size();
+    }
+
+    /**
+    Drops every entry made from this version of the field or an older one
+    */
+    void invalidate_up_to(uint64_t field_version) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            auto next = std::next(it);
+            if (it->key.field_version <= field_version) {
+                remove(it);
+            }
+            it = next;
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        statistics.bytes = 0;
+        statistics.entries = 0;
+    }
+
+    MeshCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        std::shared_ptr<const Mesh<F>> mesh;
+        size_t bytes;
+    };
+
+    void remove(typename std::list<Entry>::iterator entry) {
+        statistics.bytes -= entry->bytes;
+        index.erase(entry->key);
+        entries.erase(entry);
+        statistics.entries = entries.size();
+    }
+
+    size_t byte_budget;
+    mutable std::mutex mutex;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator, MeshCacheKeyHash<F, D>> index;
+    MeshCacheStats statistics;
+};
+
+/**
+Same as `extract`, but looks the result up in `cache` first, and stores it there on a miss
+*/
+template <typename F, typename D, typename S>
+std::shared_ptr<const Mesh<F>> extract_cached(
+    MeshCache<F, D>& cache, uint64_t field_version,
+    S source, const Block<F>& block, const D& threshold, TransitionSides transition_sides,
+    const ExtractionOptions& options = {})
+{
+    const MeshCacheKey<F, D> key(block, threshold, transition_sides, field_version, options);
+    if (auto cached = cache.find(key)) {
+        return cached;
+    }
+    auto mesh = std::make_shared<const Mesh<F>>(extract(source, block, threshold, transition_sides, options));
+    const bool cancelled = options.cancelled != nullptr && options.cancelled->load();
+    if (!cancelled) {
+        cache.insert(key, mesh);
+    }
+    return mesh;
+}
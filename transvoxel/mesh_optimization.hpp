@@ -0,0 +1,308 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "structs.hpp"
+
+// Post-processing of extracted meshes for rendering. Extractions can run them directly, see
+// `ExtractionOptions::optimize_for_rendering` and `ExtractionOptions::build_meshlets`.
+
+/**
+Reorders the triangles of an index buffer for the post-transform vertex cache of GPUs, with Tipsify
+(Sander, Nehab and Barczak, 2007): fans around vertices still in the cache, in linear time.
+`cache_size` only needs to be roughly that of the hardware
+*/
+inline std::vector<size_t> optimize_vertex_cache(const std::vector<size_t>& indices, size_t vertex_count,
+                                                 size_t cache_size = 16) {
+    const size_t triangle_count = indices.size() / 3;
+    // Triangles around each vertex, in a compressed array
+    std::vector<size_t> first_adjacent(vertex_count + 1, 0);
+    for (size_t index : indices) {
+        ++first_adjacent[index + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        first_adjacent[v + 1] += first_adjacent[v];
+    }
+    std::vector<size_t> adjacent(indices.size());
+    std::vector<size_t> live_triangles(vertex_count);
+    {
+        std::vector<size_t> next_slot(first_adjacent.begin(), first_adjacent.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            adjacent[next_slot[indices[i]]++] = i / 3;
+        }
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        live_triangles[v] = first_adjacent[v + 1] - first_adjacent[v];
+    }
+
+    std::vector<size_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<size_t> dead_end;
+    std::vector<size_t> candidates;
+    std::vector<size_t> result;
+    result.reserve(indices.size());
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+
+    // Most recently used vertex that still has triangles, else the next one in input order
+    auto skip_dead_end = [&]() {
+        while (!dead_end.empty()) {
+            const size_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live_triangles[v] > 0) {
+                return v;
+            }
+        }
+        while (cursor < vertex_count && live_triangles[cursor] == 0) {
+            ++cursor;
+        }
+        return cursor;
+    };
+
+    size_t fanning = skip_dead_end();
+    while (fanning < vertex_count) {
+        candidates.clear();
+        for (size_t a = first_adjacent[fanning]; a < first_adjacent[fanning + 1]; ++a) {
+            const size_t triangle = adjacent[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (size_t k = 0; k < 3; ++k) {
+                const size_t v = indices[3 * triangle + k];
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                --live_triangles[v];
+                if (time - cache_time[v] > cache_size) {
+                    cache_time[v] = time;
+                    ++time;
+                }
+            }
+        }
+        // Next fan: the candidate that entered the cache earliest among those that would still be in it
+        // after emitting all their triangles
+        bool found = false;
+        size_t best_priority = 0;
+        for (size_t v : candidates) {
+            if (live_triangles[v] == 0) {
+                continue;
+            }
+            size_t priority = 0;
+            if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size) {
+                priority = time - cache_time[v];
+            }
+            if (!found || priority > best_priority) {
+                fanning = v;
+                best_priority = priority;
+                found = true;
+            }
+        }
+        if (!found) {
+            fanning = skip_dead_end();
+        }
+    }
+    return result;
+}
+
+/**
+Vertices transformed per triangle with a FIFO cache of `cache_size` entries: from 0.5 for ideal meshes to 3
+*/
+inline double average_cache_miss_ratio(const std::vector<size_t>& indices, size_t vertex_count,
+                                       size_t cache_size = 16) {
+    if (indices.empty()) {
+        return 0.0;
+    }
+    std::vector<size_t> entered(vertex_count, std::numeric_limits<size_t>::max());
+    size_t misses = 0;
+    for (size_t v : indices) {
+        if (entered[v] == std::numeric_limits<size_t>::max() || misses - entered[v] >= cache_size) {
+            entered[v] = misses;
+            ++misses;
+        }
+    }
+    return static_cast<double>(misses) / static_cast<double>(indices.size() / 3);
+}
+
+/**
+New index of every vertex, numbering them in the order the index buffer first uses them, so that vertex
+fetches go forward through memory. Unused vertices go last
+*/
+inline std::vector<size_t> vertex_fetch_remap(const std::vector<size_t>& indices, size_t vertex_count) {
+    constexpr size_t UNUSED = std::numeric_limits<size_t>::max();
+    std::vector<size_t> remap(vertex_count, UNUSED);
+    size_t next = 0;
+    for (size_t v : indices) {
+        if (remap[v] == UNUSED) {
+            remap[v] = next++;
+        }
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        if (remap[v] == UNUSED) {
+            remap[v] = next++;
+        }
+    }
+    return remap;
+}
+
+/**
+Moves per-vertex data of `components` values per vertex to the indices given by `remap`
+*/
+template <typename T>
+void remap_vertex_attribute(std::vector<T>& values, const std::vector<size_t>& remap, size_t components) {
+    std::vector<T> remapped(values.size());
+    for (size_t v = 0; v < remap.size(); ++v) {
+        for (size_t c = 0; c < components; ++c) {
+            remapped[components * remap[v] + c] = values[components * v + c];
+        }
+    }
+    values = std::move(remapped);
+}
+
+/**
+Vertex cache then vertex fetch optimization. Returns the vertex remap, to apply to any other per-vertex data
+*/
+template <typename F>
+std::vector<size_t> optimize_mesh(Mesh<F>& mesh, size_t cache_size = 16) {
+    const size_t vertex_count = mesh.positions.size() / 3;
+    mesh.triangle_indices = optimize_vertex_cache(mesh.triangle_indices, vertex_count, cache_size);
+    const auto remap = vertex_fetch_remap(mesh.triangle_indices, vertex_count);
+    for (size_t& index : mesh.triangle_indices) {
+        index = remap[index];
+    }
+    remap_vertex_attribute(mesh.positions, remap, 3);
+    remap_vertex_attribute(mesh.normals, remap, 3);
+    return remap;
+}
+
+/**
+Fills the bounding sphere and normal cone of a meshlet whose vertex and triangle ranges are set
+*/
+template <typename F>
+void compute_meshlet_bounds(const Mesh<F>& mesh, Meshlet<F>& meshlet) {
+    std::array<F, 3> low = { std::numeric_limits<F>::max(), std::numeric_limits<F>::max(),
+                             std::numeric_limits<F>::max() };
+    std::array<F, 3> high = { std::numeric_limits<F>::lowest(), std::numeric_limits<F>::lowest(),
+                              std::numeric_limits<F>::lowest() };
+    for (size_t i = 0; i < meshlet.vertex_count; ++i) {
+        const size_t v = mesh.meshlet_vertices[meshlet.vertex_offset + i];
+        for (size_t c = 0; c < 3; ++c) {
+            low[c] = std::min(low[c], mesh.positions[3 * v + c]);
+            high[c] = std::max(high[c], mesh.positions[3 * v + c]);
+        }
+    }
+    F squared_radius = 0;
+    for (size_t c = 0; c < 3; ++c) {
+        meshlet.center[c] = (low[c] + high[c]) / 2;
+    }
+    for (size_t i = 0; i < meshlet.vertex_count; ++i) {
+        const size_t v = mesh.meshlet_vertices[meshlet.vertex_offset + i];
+        F squared_distance = 0;
+        for (size_t c = 0; c < 3; ++c) {
+            const F d = mesh.positions[3 * v + c] - meshlet.center[c];
+            squared_distance += d * d;
+        }
+        squared_radius = std::max(squared_radius, squared_distance);
+    }
+    meshlet.radius = std::sqrt(squared_radius);
+
+    // Normal cone: around the mean of the unit triangle normals
+    std::vector<std::array<F, 3>> triangle_normals;
+    triangle_normals.reserve(meshlet.triangle_count);
+    std::array<F, 3> sum = { 0, 0, 0 };
+    for (size_t t = 0; t < meshlet.triangle_count; ++t) {
+        const uint8_t* local = &mesh.meshlet_triangles[3 * (meshlet.triangle_offset + t)];
+        const F* p[3];
+        for (size_t k = 0; k < 3; ++k) {
+            p[k] = &mesh.positions[3 * mesh.meshlet_vertices[meshlet.vertex_offset + local[k]]];
+        }
+        const F e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        const F e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        std::array<F, 3> n = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                               e1[0] * e2[1] - e1[1] * e2[0] };
+        const F length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= std::numeric_limits<F>::min()) {
+            // Degenerate: no orientation to constrain
+            continue;
+        }
+        for (size_t c = 0; c < 3; ++c) {
+            n[c] /= length;
+            sum[c] += n[c];
+        }
+        triangle_normals.push_back(n);
+    }
+    const F sum_length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+    if (triangle_normals.empty() || sum_length <= std::numeric_limits<F>::epsilon()) {
+        meshlet.cone_axis = { 0, 0, 1 };
+        meshlet.cone_cutoff = -1;
+        return;
+    }
+    for (size_t c = 0; c < 3; ++c) {
+        meshlet.cone_axis[c] = sum[c] / sum_length;
+    }
+    meshlet.cone_cutoff = 1;
+    for (const auto& n : triangle_normals) {
+        const F cosine = n[0] * meshlet.cone_axis[0] + n[1] * meshlet.cone_axis[1] + n[2] * meshlet.cone_axis[2];
+        meshlet.cone_cutoff = std::min(meshlet.cone_cutoff, cosine);
+    }
+}
+
+/**
+Splits the mesh into meshlets of at most `max_vertices` vertices and `max_triangles` triangles, greedily in
+index order. Run it after `optimize_mesh`, whose order keeps neighbouring triangles together
+*/
+template <typename F>
+void build_meshlets(Mesh<F>& mesh, size_t max_vertices = 64, size_t max_triangles = 124) {
+    assert(max_vertices >= 3 && max_vertices <= 256 && max_triangles >= 1);
+    constexpr uint32_t NOT_IN_MESHLET = std::numeric_limits<uint32_t>::max();
+    const size_t vertex_count = mesh.positions.size() / 3;
+    mesh.meshlets.clear();
+    mesh.meshlet_vertices.clear();
+    mesh.meshlet_triangles.clear();
+    std::vector<uint32_t> local_index(vertex_count, NOT_IN_MESHLET);
+    Meshlet<F> current{};
+
+    auto finish = [&]() {
+        if (current.triangle_count == 0) {
+            return;
+        }
+        compute_meshlet_bounds(mesh, current);
+        for (size_t i = 0; i < current.vertex_count; ++i) {
+            local_index[mesh.meshlet_vertices[current.vertex_offset + i]] = NOT_IN_MESHLET;
+        }
+        mesh.meshlets.push_back(current);
+        current = Meshlet<F>{};
+        current.vertex_offset = static_cast<uint32_t>(mesh.meshlet_vertices.size());
+        current.triangle_offset = static_cast<uint32_t>(mesh.meshlet_triangles.size() / 3);
+    };
+
+    for (size_t t = 0; t < mesh.num_tris(); ++t) {
+        const size_t a = mesh.triangle_indices[3 * t];
+        const size_t b = mesh.triangle_indices[3 * t + 1];
+        const size_t c = mesh.triangle_indices[3 * t + 2];
+        const size_t new_vertices = (local_index[a] == NOT_IN_MESHLET)
+            + (local_index[b] == NOT_IN_MESHLET && b != a)
+            + (local_index[c] == NOT_IN_MESHLET && c != a && c != b);
+        if (current.vertex_count + new_vertices > max_vertices || current.triangle_count == max_triangles) {
+            finish();
+        }
+        for (size_t v : { a, b, c }) {
+            if (local_index[v] == NOT_IN_MESHLET) {
+                local_index[v] = current.vertex_count++;
+                mesh.meshlet_vertices.push_back(static_cast<uint32_t>(v));
+            }
+            mesh.meshlet_triangles.push_back(static_cast<uint8_t>(local_index[v]));
+        }
+        ++current.triangle_count;
+    }
+    finish();
+}
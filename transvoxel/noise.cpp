@@ -0,0 +1,33 @@
+#include "noise.hpp"
+#include "implementation/cpu_dispatch.hpp"
+
+namespace {
+
+void noise_batch_baseline(NoiseKind kind, const FractalSettings& settings,
+                          const float* x, const float* y, const float* z, float* out, size_t count) {
+#if defined(__AVX512F__)
+    noise_batch<Avx512Lanes>(kind, settings, x, y, z, out, count);
+#elif defined(__AVX2__)
+    noise_batch<Avx2Lanes>(kind, settings, x, y, z, out, count);
+#elif defined(__SSE2__)
+    noise_batch<Sse2Lanes>(kind, settings, x, y, z, out, count);
+#else
+    noise_batch<ScalarLanes>(kind, settings, x, y, z, out, count);
+#endif
+}
+
+}
+
+void evaluate_noise_batch(NoiseKind kind, const FractalSettings& settings,
+                          const float* x, const float* y, const float* z, float* out, size_t count) {
+#if defined(TRANSVOXEL_RUNTIME_DISPATCH)
+    static const auto kernel = select_kernel(&noise_batch_baseline, &noise_batch_avx2, &noise_batch_avx512);
+    kernel(kind, settings, x, y, z, out, count);
+#else
+    noise_batch_baseline(kind, settings, x, y, z, out, count);
+#endif
+}
+
+float evaluate_noise(NoiseKind kind, const FractalSettings& settings, float x, float y, float z) {
+    return noise_of_kind<ScalarLanes>(kind, x, y, z, settings);
+}
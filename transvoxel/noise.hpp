@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "density.hpp"
+#include "implementation/noise_kernels.hpp"
+
+/**
+Evaluates a batch of noise samples with the widest instruction set available. The results are bitwise
+identical to evaluating the points one by one
+*/
+void evaluate_noise_batch(NoiseKind kind, const FractalSettings& settings,
+                          const float* x, const float* y, const float* z, float* out, size_t count);
+
+/**
+Evaluates noise at a single point. Built with the kernels, away from the flags of the calling code, so that it
+gives the same bits as the batches whatever those flags
+*/
+float evaluate_noise(NoiseKind kind, const FractalSettings& settings, float x, float y, float z);
+
+/**
+Common part of the built-in noise fields. Coordinates times frequencies must stay within the int32 range
+*/
+struct NoiseField : public ScalarField<float, float> {
+    NoiseField(NoiseKind kind, const FractalSettings& settings) : kind(kind), settings(settings) {}
+
+    float get_density(float x, float y, float z) const override {
+        return evaluate_noise(kind, settings, x, y, z);
+    }
+
+    void get_densities(const float* x, const float* y, const float* z, float* densities, size_t count) const override {
+        evaluate_noise_batch(kind, settings, x, y, z, densities, count);
+    }
+
+    NoiseKind kind;
+    FractalSettings settings;
+};
+
+/**
+A single octave of gradient noise, roughly within [-1, 1]
+*/
+struct GradientNoise : public NoiseField {
+    GradientNoise(uint32_t seed = 0, float frequency = 1.0f)
+        : NoiseField(NoiseKind::Gradient, FractalSettings{ .seed = seed, .frequency = frequency, .octaves = 1 }) {}
+};
+
+/**
+A single octave of simplex noise, roughly within [-1, 1]. Fewer corners per sample than gradient noise, and no
+axis aligned artifacts
+*/
+struct SimplexNoise : public NoiseField {
+    SimplexNoise(uint32_t seed = 0, float frequency = 1.0f)
+        : NoiseField(NoiseKind::Simplex, FractalSettings{ .seed = seed, .frequency = frequency, .octaves = 1 }) {}
+};
+
+/**
+Fractional Brownian motion: octaves of gradient noise of increasing frequency and decreasing amplitude
+*/
+struct FractalNoise : public NoiseField {
+    FractalNoise(const FractalSettings& settings = {}) : NoiseField(NoiseKind::Fractal, settings) {}
+};
+
+/**
+Ridged multifractal, giving sharp crests. Always positive
+*/
+struct RidgedNoise : public NoiseField {
+    RidgedNoise(const FractalSettings& settings = {}) : NoiseField(NoiseKind::Ridged, settings) {}
+};
+
+/**
+Evaluates `field` at points displaced by fractal noise, `strength` being the largest displacement
+*/
+template <typename SF>
+struct DomainWarp : public ScalarField<float, float> {
+    DomainWarp(SF field, const FractalSettings& warp, float strength)
+        : field(std::move(field)), warp(warp), strength(strength) {}
+
+    float get_density(float x, float y, float z) const override {
+        const float wx = evaluate_noise(NoiseKind::Fractal, warp_settings(0), x, y, z);
+        const float wy = evaluate_noise(NoiseKind::Fractal, warp_settings(1), x, y, z);
+        const float wz = evaluate_noise(NoiseKind::Fractal, warp_settings(2), x, y, z);
+        return field.get_density(x + strength * wx, y + strength * wy, z + strength * wz);
+    }
+
+    void get_densities(const float* x, const float* y, const float* z, float* densities, size_t count) const override {
+        constexpr size_t CHUNK = 64;
+        float warped[3][CHUNK];
+        float offsets[CHUNK];
+        for (size_t start = 0; start < count; start += CHUNK) {
+            const size_t chunk_size = std::min(CHUNK, count - start);
+            const float* coordinates[3] = { x + start, y + start, z + start };
+            for (size_t axis = 0; axis < 3; ++axis) {
+                evaluate_noise_batch(NoiseKind::Fractal, warp_settings(axis),
+                                     x + start, y + start, z + start, offsets, chunk_size);
+                for (size_t i = 0; i < chunk_size; ++i) {
+                    warped[axis][i] = coordinates[axis][i] + strength * offsets[i];
+                }
+            }
+            field.get_densities(warped[0], warped[1], warped[2], densities + start, chunk_size);
+        }
+    }
+
+    /// Each axis gets its own seeds, far enough apart not to share octaves
+    FractalSettings warp_settings(size_t axis) const {
+        FractalSettings settings = warp;
+        settings.seed = warp.seed + static_cast<uint32_t>(axis) * 7919u;
+        return settings;
+    }
+
+    SF field;
+    FractalSettings warp;
+    float strength;
+};
+
+template <>
+struct FieldThreading<GradientNoise> {
+    static constexpr bool thread_safe() {
+        return true;
+    }
+};
+
+template <>
+struct FieldThreading<SimplexNoise> {
+    static constexpr bool thread_safe() {
+        return true;
+    }
+};
+
+template <>
+struct FieldThreading<FractalNoise> {
+    static constexpr bool thread_safe() {
+        return true;
+    }
+};
+
+template <>
+struct FieldThreading<RidgedNoise> {
+    static constexpr bool thread_safe() {
+        return true;
+    }
+};
+
+template <typename SF>
+struct FieldThreading<DomainWarp<SF>> {
+    static constexpr bool thread_safe() {
+        return FieldThreading<SF>::thread_safe();
+    }
+};
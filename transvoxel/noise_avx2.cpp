@@ -0,0 +1,10 @@
+#include "noise.hpp"
+
+#if !defined(__AVX2__)
+#error "Build with -mavx2"
+#endif
+
+void noise_batch_avx2(NoiseKind kind, const FractalSettings& settings,
+                      const float* x, const float* y, const float* z, float* out, size_t count) {
+    noise_batch<Avx2Lanes>(kind, settings, x, y, z, out, count);
+}
@@ -0,0 +1,10 @@
+#include "noise.hpp"
+
+#if !defined(__AVX512F__)
+#error "Build with -mavx512f"
+#endif
+
+void noise_batch_avx512(NoiseKind kind, const FractalSettings& settings,
+                        const float* x, const float* y, const float* z, float* out, size_t count) {
+    noise_batch<Avx512Lanes>(kind, settings, x, y, z, out, count);
+}
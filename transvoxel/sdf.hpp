@@ -0,0 +1,590 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "density.hpp"
+
+// Signed distance fields built as a tree of primitives and boolean operations. Every node can bound its
+// distance over a box with interval arithmetic, which is used both to skip blocks far from the surface and to
+// prune, for each block, the parts of the tree that cannot change the distances in there.
+
+/**
+Range of values, with `low <= high`
+*/
+struct Interval {
+    float low;
+    float high;
+
+    Interval operator+(const Interval& other) const {
+        return { low + other.low, high + other.high };
+    }
+
+    Interval operator-(const Interval& other) const {
+        return { low - other.high, high - other.low };
+    }
+
+    Interval operator-() const {
+        return { -high, -low };
+    }
+
+    Interval operator*(float factor) const {
+        return factor >= 0.0f ? Interval{ low * factor, high * factor } : Interval{ high * factor, low * factor };
+    }
+
+    Interval operator+(float offset) const {
+        return { low + offset, high + offset };
+    }
+
+    static Interval min(const Interval& a, const Interval& b) {
+        return { std::min(a.low, b.low), std::min(a.high, b.high) };
+    }
+
+    static Interval max(const Interval& a, const Interval& b) {
+        return { std::max(a.low, b.low), std::max(a.high, b.high) };
+    }
+
+    static Interval abs(const Interval& a) {
+        if (a.low >= 0.0f) {
+            return a;
+        } else if (a.high <= 0.0f) {
+            return -a;
+        } else {
+            return { 0.0f, std::max(-a.low, a.high) };
+        }
+    }
+
+    static Interval square(const Interval& a) {
+        const Interval positive = abs(a);
+        return { positive.low * positive.low, positive.high * positive.high };
+    }
+
+    static Interval sqrt(const Interval& a) {
+        return { std::sqrt(std::max(a.low, 0.0f)), std::sqrt(std::max(a.high, 0.0f)) };
+    }
+};
+
+struct Aabb {
+    std::array<float, 3> low;
+    std::array<float, 3> high;
+
+    Interval axis(size_t i) const {
+        return { low[i], high[i] };
+    }
+};
+
+class SdfNode;
+using SdfNodePtr = std::shared_ptr<const SdfNode>;
+
+/**
+A node of the distance tree. Negative distances are inside the shape.
+Nodes are immutable, and shared between the trees pruned from the same original
+*/
+class SdfNode : public std::enable_shared_from_this<SdfNode> {
+public:
+    virtual float distance(float x, float y, float z) const = 0;
+
+    /**
+    Bounds of the distance over the box
+    */
+    virtual Interval distance(const Aabb& box) const = 0;
+
+    /**
+    A tree giving the same distances within the box, without the branches that do not matter there
+    */
+    virtual SdfNodePtr prune(const Aabb& box) const {
+        return shared_from_this();
+    }
+
+    /**
+    Number of nodes in the tree, for statistics
+    */
+    virtual size_t node_count() const {
+        return 1;
+    }
+
+    virtual ~SdfNode() = default;
+};
+
+class SdfSphere : public SdfNode {
+public:
+    SdfSphere(const std::array<float, 3>& center, float radius) : center(center), radius(radius) {}
+
+    float distance(float x, float y, float z) const override {
+        const float dx = x - center[0];
+        const float dy = y - center[1];
+        const float dz = z - center[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+    }
+
+    Interval distance(const Aabb& box) const override {
+        // Exact: nearest point of the box, and farthest corner
+        float nearest = 0.0f;
+        float farthest = 0.0f;
+        for (size_t i = 0; i < 3; ++i) {
+            const float below = box.low[i] - center[i];
+            const float above = center[i] - box.high[i];
+            const float gap = std::max({ below, above, 0.0f });
+            const float reach = std::max(std::abs(below), std::abs(above));
+            nearest += gap * gap;
+            farthest += reach * reach;
+        }
+        return { std::sqrt(nearest) - radius, std::sqrt(farthest) - radius };
+    }
+
+private:
+    std::array<float, 3> center;
+    float radius;
+};
+
+/**
+Axis aligned box, rotate it with `SdfTransform`
+*/
+class SdfBox : public SdfNode {
+public:
+    SdfBox(const std::array<float, 3>& center, const std::array<float, 3>& half_size)
+        : center(center), half_size(half_size) {}
+
+    float distance(float x, float y, float z) const override {
+        const std::array<float, 3> p = { x, y, z };
+        float outside = 0.0f;
+        float inside = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < 3; ++i) {
+            const float q = std::abs(p[i] - center[i]) - half_size[i];
+            outside += std::max(q, 0.0f) * std::max(q, 0.0f);
+            inside = std::max(inside, q);
+        }
+        return std::sqrt(outside) + std::min(inside, 0.0f);
+    }
+
+    Interval distance(const Aabb& box) const override {
+        Interval outside = { 0.0f, 0.0f };
+        Interval inside = { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+        for (size_t i = 0; i < 3; ++i) {
+            const Interval q = Interval::abs(box.axis(i) + -center[i]) + -half_size[i];
+            outside = outside + Interval::square(Interval::max(q, { 0.0f, 0.0f }));
+            inside = Interval::max(inside, q);
+        }
+        return Interval::sqrt(outside) + Interval::min(inside, { 0.0f, 0.0f });
+    }
+
+private:
+    std::array<float, 3> center;
+    std::array<float, 3> half_size;
+};
+
+/**
+Half space below the plane `dot(normal, p) = offset`. `normal` must be of unit length
+*/
+class SdfPlane : public SdfNode {
+public:
+    SdfPlane(const std::array<float, 3>& normal, float offset) : normal(normal), offset(offset) {}
+
+    float distance(float x, float y, float z) const override {
+        return normal[0] * x + normal[1] * y + normal[2] * z - offset;
+    }
+
+    Interval distance(const Aabb& box) const override {
+        return box.axis(0) * normal[0] + box.axis(1) * normal[1] + box.axis(2) * normal[2] + -offset;
+    }
+
+private:
+    std::array<float, 3> normal;
+    float offset;
+};
+
+/**
+Union of any number of shapes: the minimum distance. Children that are farther than another child everywhere
+in the box get pruned
+*/
+class SdfUnion : public SdfNode {
+public:
+    SdfUnion(std::vector<SdfNodePtr> children) : children(std::move(children)) {}
+
+    float distance(float x, float y, float z) const override {
+        float result = std::numeric_limits<float>::infinity();
+        for (const auto& child : children) {
+            result = std::min(result, child->distance(x, y, z));
+        }
+        return result;
+    }
+
+    Interval distance(const Aabb& box) const override {
+        Interval result = { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+        for (const auto& child : children) {
+            result = Interval::min(result, child->distance(box));
+        }
+        return result;
+    }
+
+    SdfNodePtr prune(const Aabb& box) const override {
+        std::vector<Interval> bounds;
+        bounds.reserve(children.size());
+        float lowest_high = std::numeric_limits<float>::infinity();
+        for (const auto& child : children) {
+            bounds.push_back(child->distance(box));
+            lowest_high = std::min(lowest_high, bounds.back().high);
+        }
+        std::vector<SdfNodePtr> kept;
+        bool changed = false;
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (bounds[i].low > lowest_high) {
+                changed = true;
+                continue;
+            }
+            kept.push_back(children[i]->prune(box));
+            changed = changed || kept.back() != children[i];
+        }
+        if (kept.size() == 1) {
+            return kept.front();
+        } else if (!changed) {
+            return shared_from_this();
+        } else {
+            return std::make_shared<SdfUnion>(std::move(kept));
+        }
+    }
+
+    size_t node_count() const override {
+        size_t count = 1;
+        for (const auto& child : children) {
+            count += child->node_count();
+        }
+        return count;
+    }
+
+private:
+    std::vector<SdfNodePtr> children;
+};
+
+/**
+Intersection of any number of shapes: the maximum distance. Children that are nearer than another child
+everywhere in the box get pruned
+*/
+class SdfIntersection : public SdfNode {
+public:
+    SdfIntersection(std::vector<SdfNodePtr> children) : children(std::move(children)) {}
+
+    float distance(float x, float y, float z) const override {
+        float result = -std::numeric_limits<float>::infinity();
+        for (const auto& child : children) {
+            result = std::max(result, child->distance(x, y, z));
+        }
+        return result;
+    }
+
+    Interval distance(const Aabb& box) const override {
+        Interval result = { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+        for (const auto& child : children) {
+            result = Interval::max(result, child->distance(box));
+        }
+        return result;
+    }
+
+    SdfNodePtr prune(const Aabb& box) const override {
+        std::vector<Interval> bounds;
+        bounds.reserve(children.size());
+        float highest_low = -std::numeric_limits<float>::infinity();
+        for (const auto& child : children) {
+            bounds.push_back(child->distance(box));
+            highest_low = std::max(highest_low, bounds.back().low);
+        }
+        std::vector<SdfNodePtr> kept;
+        bool changed = false;
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (bounds[i].high < highest_low) {
+                changed = true;
+                continue;
+            }
+            kept.push_back(children[i]->prune(box));
+            changed = changed || kept.back() != children[i];
+        }
+        if (kept.size() == 1) {
+            return kept.front();
+        } else if (!changed) {
+            return shared_from_this();
+        } else {
+            return std::make_shared<SdfIntersection>(std::move(kept));
+        }
+    }
+
+    size_t node_count() const override {
+        size_t count = 1;
+        for (const auto& child : children) {
+            count += child->node_count();
+        }
+        return count;
+    }
+
+private:
+    std::vector<SdfNodePtr> children;
+};
+
+/**
+`shape` with `tool` carved out of it: max(shape, -tool)
+*/
+class SdfSubtraction : public SdfNode {
+public:
+    SdfSubtraction(SdfNodePtr shape, SdfNodePtr tool) : shape(std::move(shape)), tool(std::move(tool)) {}
+
+    float distance(float x, float y, float z) const override {
+        return std::max(shape->distance(x, y, z), -tool->distance(x, y, z));
+    }
+
+    Interval distance(const Aabb& box) const override {
+        return Interval::max(shape->distance(box), -tool->distance(box));
+    }
+
+    SdfNodePtr prune(const Aabb& box) const override {
+        const Interval shape_bounds = shape->distance(box);
+        const Interval carved_bounds = -tool->distance(box);
+        if (carved_bounds.high < shape_bounds.low) {
+            // The tool does not reach into the box
+            return shape->prune(box);
+        }
+        auto pruned_shape = shape->prune(box);
+        auto pruned_tool = tool->prune(box);
+        if (pruned_shape == shape && pruned_tool == tool) {
+            return shared_from_this();
+        }
+        return std::make_shared<SdfSubtraction>(std::move(pruned_shape), std::move(pruned_tool));
+    }
+
+    size_t node_count() const override {
+        return 1 + shape->node_count() + tool->node_count();
+    }
+
+private:
+    SdfNodePtr shape;
+    SdfNodePtr tool;
+};
+
+enum class SdfBlend {
+    Union,
+    Intersection,
+    Subtraction
+};
+
+/**
+Boolean operation with the seam rounded over a width `k`, using the quadratic smooth minimum.
+Away from the seam (distances more than `k` apart) it is exactly the sharp operation, which the pruning relies on
+*/
+class SdfSmooth : public SdfNode {
+public:
+    SdfSmooth(SdfBlend blend, SdfNodePtr a, SdfNodePtr b, float k)
+        : blend(blend), a(std::move(a)), b(std::move(b)), k(k) {}
+
+    float distance(float x, float y, float z) const override {
+        const float da = a->distance(x, y, z);
+        const float db = b->distance(x, y, z);
+        switch (blend) {
+        case SdfBlend::Union:
+            return smooth_min(da, db);
+        case SdfBlend::Intersection:
+            return -smooth_min(-da, -db);
+        default:
+            return -smooth_min(-da, db);
+        }
+    }
+
+    Interval distance(const Aabb& box) const override {
+        // The smooth minimum is at most k/4 below the sharp one
+        const Interval da = a->distance(box);
+        const Interval db = b->distance(box);
+        switch (blend) {
+        case SdfBlend::Union: {
+            const Interval sharp = Interval::min(da, db);
+            return { sharp.low - 0.25f * k, sharp.high };
+        }
+        case SdfBlend::Intersection: {
+            const Interval sharp = Interval::max(da, db);
+            return { sharp.low, sharp.high + 0.25f * k };
+        }
+        default: {
+            const Interval sharp = Interval::max(da, -db);
+            return { sharp.low, sharp.high + 0.25f * k };
+        }
+        }
+    }
+
+    SdfNodePtr prune(const Aabb& box) const override {
+        // In smooth_min terms, the operands are (a, b), (-a, -b) or (-a, b)
+        const Interval da = a->distance(box);
+        const Interval db = b->distance(box);
+        const Interval first = blend == SdfBlend::Union ? da : -da;
+        const Interval second = blend == SdfBlend::Intersection ? -db : db;
+        if (second.low - first.high > k) {
+            // Only the first operand counts
+            return a->prune(box);
+        }
+        if (blend != SdfBlend::Subtraction && first.low - second.high > k) {
+            return b->prune(box);
+        }
+        auto pruned_a = a->prune(box);
+        auto pruned_b = b->prune(box);
+        if (pruned_a == a && pruned_b == b) {
+            return shared_from_this();
+        }
+        return std::make_shared<SdfSmooth>(blend, std::move(pruned_a), std::move(pruned_b), k);
+    }
+
+    size_t node_count() const override {
+        return 1 + a->node_count() + b->node_count();
+    }
+
+private:
+    float smooth_min(float da, float db) const {
+        const float h = std::max(k - std::abs(da - db), 0.0f) / k;
+        return std::min(da, db) - h * h * k * 0.25f;
+    }
+
+    SdfBlend blend;
+    SdfNodePtr a;
+    SdfNodePtr b;
+    float k;
+};
+
+/**
+Places a shape in the world: rotated by `rotation` (orthonormal, row major), scaled uniformly by `scale`,
+then moved by `translation`
+*/
+class SdfTransform : public SdfNode {
+public:
+    SdfTransform(SdfNodePtr child, const std::array<float, 9>& rotation, const std::array<float, 3>& translation,
+                 float scale = 1.0f)
+        : child(std::move(child)), rotation(rotation), translation(translation), scale(scale) {}
+
+    float distance(float x, float y, float z) const override {
+        const auto local = point_to_local({ x, y, z });
+        return scale * child->distance(local[0], local[1], local[2]);
+    }
+
+    Interval distance(const Aabb& box) const override {
+        return child->distance(to_local(box)) * scale;
+    }
+
+    SdfNodePtr prune(const Aabb& box) const override {
+        auto pruned = child->prune(to_local(box));
+        if (pruned == child) {
+            return shared_from_this();
+        }
+        return std::make_shared<SdfTransform>(std::move(pruned), rotation, translation, scale);
+    }
+
+    size_t node_count() const override {
+        return 1 + child->node_count();
+    }
+
+private:
+    std::array<float, 3> point_to_local(const std::array<float, 3>& p) const {
+        const float px = p[0] - translation[0];
+        const float py = p[1] - translation[1];
+        const float pz = p[2] - translation[2];
+        // Inverse rotation: transposed matrix
+        return {
+            (rotation[0] * px + rotation[3] * py + rotation[6] * pz) / scale,
+            (rotation[1] * px + rotation[4] * py + rotation[7] * pz) / scale,
+            (rotation[2] * px + rotation[5] * py + rotation[8] * pz) / scale,
+        };
+    }
+
+    /**
+    Box enclosing the 8 corners of `box`, in the child's space
+    */
+    Aabb to_local(const Aabb& box) const {
+        Aabb local = {
+            { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+              std::numeric_limits<float>::infinity() },
+            { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+              -std::numeric_limits<float>::infinity() },
+        };
+        for (size_t corner = 0; corner < 8; ++corner) {
+            const auto p = point_to_local({
+                (corner & 1) ? box.high[0] : box.low[0],
+                (corner & 2) ? box.high[1] : box.low[1],
+                (corner & 4) ? box.high[2] : box.low[2],
+            });
+            for (size_t i = 0; i < 3; ++i) {
+                local.low[i] = std::min(local.low[i], p[i]);
+                local.high[i] = std::max(local.high[i], p[i]);
+            }
+        }
+        return local;
+    }
+
+    SdfNodePtr child;
+    std::array<float, 9> rotation;
+    std::array<float, 3> translation;
+    float scale;
+};
+
+inline SdfNodePtr sdf_sphere(const std::array<float, 3>& center, float radius) {
+    return std::make_shared<SdfSphere>(center, radius);
+}
+
+inline SdfNodePtr sdf_box(const std::array<float, 3>& center, const std::array<float, 3>& half_size) {
+    return std::make_shared<SdfBox>(center, half_size);
+}
+
+inline SdfNodePtr sdf_plane(const std::array<float, 3>& normal, float offset) {
+    return std::make_shared<SdfPlane>(normal, offset);
+}
+
+inline SdfNodePtr sdf_union(std::vector<SdfNodePtr> children) {
+    return std::make_shared<SdfUnion>(std::move(children));
+}
+
+inline SdfNodePtr sdf_intersection(std::vector<SdfNodePtr> children) {
+    return std::make_shared<SdfIntersection>(std::move(children));
+}
+
+inline SdfNodePtr sdf_subtraction(SdfNodePtr shape, SdfNodePtr tool) {
+    return std::make_shared<SdfSubtraction>(std::move(shape), std::move(tool));
+}
+
+inline SdfNodePtr sdf_smooth(SdfBlend blend, SdfNodePtr a, SdfNodePtr b, float k) {
+    return std::make_shared<SdfSmooth>(blend, std::move(a), std::move(b), k);
+}
+
+inline SdfNodePtr sdf_transform(SdfNodePtr child, const std::array<float, 9>& rotation,
+                                const std::array<float, 3>& translation, float scale = 1.0f) {
+    return std::make_shared<SdfTransform>(std::move(child), rotation, translation, scale);
+}
+
+/**
+Scalar field of a distance tree, positive inside the shape (density is minus the distance).
+When sampled through a `WorldMappingVoxelSource`, the tree is pruned to each block, and blocks that the
+distance bounds prove empty or full are not sampled at all
+*/
+struct SdfField : public ScalarField<float, float> {
+    SdfField(SdfNodePtr root) : root(std::move(root)) {}
+
+    float get_density(float x, float y, float z) const override {
+        return -root->distance(x, y, z);
+    }
+
+    std::optional<DensityBounds<float>> density_bounds(const std::array<float, 3>& low,
+                                                       const std::array<float, 3>& high) const override {
+        const Interval distance = root->distance(Aabb{ low, high });
+        return DensityBounds<float>{ -distance.high, -distance.low };
+    }
+
+    void restrict_to(const std::array<float, 3>& low, const std::array<float, 3>& high) override {
+        root = root->prune(Aabb{ low, high });
+    }
+
+    SdfNodePtr root;
+};
+
+template <>
+struct FieldThreading<SdfField> {
+    static constexpr bool thread_safe() {
+        return true;
+    }
+};
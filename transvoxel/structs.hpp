@@ -1,9 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <ostream>
 #include <vector>
 
+#include "transition_sides.hpp"
+
 template <typename F> struct BlockDims {
   static constexpr int kDimension = 3;
 
@@ -25,6 +33,53 @@ template <typename F> struct Block {
   size_t subdivisions;
 };
 
+struct Executor;
+
+/**
+Order of the voxel densities in the cache of an extraction. Both include the
+one voxel layer out of the block read for gradients
+*/
+enum class DensityCacheLayout {
+  /// X, then Y, then Z rows
+  Linear,
+  /// 4x4x4 tiles of voxels, each one linear, and regular cells visited tile by
+  /// tile. Keeps the voxels read for gradients close in memory, for blocks
+  /// much larger than the CPU caches; costs more index arithmetic otherwise.
+  /// Same geometry, in another vertex and triangle order
+  Tiled
+};
+
+/**
+Optional settings of an extraction. The defaults give a plain single threaded extraction
+*/
+struct ExtractionOptions {
+  /// Runs the density prefetch on this executor, if the source is declared
+  /// thread safe through `FieldThreading`. Null means serial
+  const Executor *executor = nullptr;
+  /// Polled between slices of regular cells and before the transition cells.
+  /// Once set, the extraction stops early and returns an incomplete mesh
+  const std::atomic<bool> *cancelled = nullptr;
+  /// Only samples at full resolution the tiles of the block where the source
+  /// density bounds (see `ScalarField::density_bounds`) do not rule out the
+  /// surface. Gives the same mesh, with fewer field evaluations on smooth fields
+  bool adaptive_sampling = false;
+  /// Reorders the triangles for the post-transform vertex cache of GPUs, then
+  /// the vertices in order of first use (see `mesh_optimization.hpp`). Runs on
+  /// the extracting thread
+  bool optimize_for_rendering = false;
+  /// Also splits the mesh into meshlets with bounds (`Mesh::meshlets`).
+  /// Implies `optimize_for_rendering`
+  bool build_meshlets = false;
+  /// Builds a BVH over the triangles for ray and sphere queries (`Mesh::bvh`)
+  bool build_bvh = false;
+  /// Normalizes vertex normals with a reciprocal square root estimate refined
+  /// by a Newton step rather than a division. Within about 1e-6, but not
+  /// bitwise reproducible across instruction sets. Positions stay exact
+  bool fast_normals = false;
+  /// See `DensityCacheLayout`
+  DensityCacheLayout cache_layout = DensityCacheLayout::Linear;
+};
+
 template <typename F> struct Vertex {
   std::array<F, 3> position;
   std::array<F, 3> normal;
@@ -34,10 +89,195 @@ template <typename F> struct Triangle {
   std::array<Vertex<F>, 3> vertices;
 };
 
+/**
+Bounding volumes of a mesh, grown one vertex at a time as the extractor emits them
+*/
+template <typename F> struct MeshBounds {
+  /// Axis aligned box, with `low > high` while empty
+  std::array<F, 3> low = {std::numeric_limits<F>::max(),
+                          std::numeric_limits<F>::max(),
+                          std::numeric_limits<F>::max()};
+  std::array<F, 3> high = {std::numeric_limits<F>::lowest(),
+                           std::numeric_limits<F>::lowest(),
+                           std::numeric_limits<F>::lowest()};
+  /// Bounding sphere: Ritter's incremental one, or the one around the box if
+  /// smaller (see `shrink_sphere_to_box`). Negative radius while empty
+  std::array<F, 3> sphere_center = {0, 0, 0};
+  F sphere_radius = -1;
+  /// All the vertex normals n have dot(n, cone_axis) >= cone_cutoff. The axis
+  /// is null until a normal is added, and a cutoff of -1 means no useful cone
+  std::array<F, 3> cone_axis = {0, 0, 0};
+  F cone_cutoff = 1;
+
+  bool empty() const { return sphere_radius < 0; }
+
+  void add_position(const std::array<F, 3> &p) {
+    for (size_t i = 0; i < 3; ++i) {
+      low[i] = std::min(low[i], p[i]);
+      high[i] = std::max(high[i], p[i]);
+    }
+    merge_sphere(p, 0);
+  }
+
+  /// Normals of zero length (flat density) are ignored
+  void add_normal(const std::array<F, 3> &n) {
+    if (n[0] == 0 && n[1] == 0 && n[2] == 0) {
+      return;
+    }
+    // Fast path: already in the cone
+    if (n[0] * cone_axis[0] + n[1] * cone_axis[1] + n[2] * cone_axis[2] >=
+        cone_cutoff) {
+      return;
+    }
+    merge_cone(n, 1);
+  }
+
+  void merge(const MeshBounds &other) {
+    for (size_t i = 0; i < 3; ++i) {
+      low[i] = std::min(low[i], other.low[i]);
+      high[i] = std::max(high[i], other.high[i]);
+    }
+    if (!other.empty()) {
+      merge_sphere(other.sphere_center, other.sphere_radius);
+    }
+    if (other.cone_axis != std::array<F, 3>{0, 0, 0}) {
+      merge_cone(other.cone_axis, other.cone_cutoff);
+    }
+  }
+
+  /// The incremental sphere can end up bigger than the one around the box,
+  /// on meshes spread all over their block
+  void shrink_sphere_to_box() {
+    if (empty()) {
+      return;
+    }
+    F squared = 0;
+    for (size_t i = 0; i < 3; ++i) {
+      squared += (high[i] - low[i]) * (high[i] - low[i]);
+    }
+    const F box_radius = std::sqrt(squared) / 2;
+    if (box_radius < sphere_radius) {
+      for (size_t i = 0; i < 3; ++i) {
+        sphere_center[i] = (low[i] + high[i]) / 2;
+      }
+      sphere_radius = box_radius;
+    }
+  }
+
+private:
+  /// Smallest sphere holding this one and the given one
+  void merge_sphere(const std::array<F, 3> &center, F radius) {
+    if (empty()) {
+      sphere_center = center;
+      sphere_radius = radius;
+      return;
+    }
+    const std::array<F, 3> offset = {center[0] - sphere_center[0],
+                                     center[1] - sphere_center[1],
+                                     center[2] - sphere_center[2]};
+    const F distance = std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] +
+                                 offset[2] * offset[2]);
+    if (distance + radius <= sphere_radius) {
+      return;
+    }
+    if (distance + sphere_radius <= radius) {
+      sphere_center = center;
+      sphere_radius = radius;
+      return;
+    }
+    const F new_radius = (distance + sphere_radius + radius) / 2;
+    const F shift = (new_radius - sphere_radius) / distance;
+    for (size_t i = 0; i < 3; ++i) {
+      sphere_center[i] += shift * offset[i];
+    }
+    sphere_radius = new_radius;
+  }
+
+  /// Smallest cone holding this one and the given one (`axis` of unit length)
+  void merge_cone(const std::array<F, 3> &axis, F cutoff) {
+    const F length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] +
+                               axis[2] * axis[2]);
+    const std::array<F, 3> unit = {axis[0] / length, axis[1] / length,
+                                   axis[2] / length};
+    if (cone_axis == std::array<F, 3>{0, 0, 0}) {
+      cone_axis = unit;
+      cone_cutoff = cutoff;
+      return;
+    }
+    if (cone_cutoff <= -1) {
+      return;
+    }
+    const F pi = static_cast<F>(3.14159265358979323846);
+    const F angle = std::acos(std::clamp<F>(cone_cutoff, -1, 1));
+    const F other_angle = std::acos(std::clamp<F>(cutoff, -1, 1));
+    const F between = std::acos(std::clamp<F>(
+        unit[0] * cone_axis[0] + unit[1] * cone_axis[1] + unit[2] * cone_axis[2],
+        -1, 1));
+    if (between + other_angle <= angle) {
+      return;
+    }
+    if (between + angle <= other_angle) {
+      cone_axis = unit;
+      cone_cutoff = cutoff;
+      return;
+    }
+    const F new_angle = (between + angle + other_angle) / 2;
+    const F sin_between = std::sin(between);
+    if (new_angle >= pi || sin_between <= std::numeric_limits<F>::epsilon()) {
+      cone_cutoff = -1;
+      return;
+    }
+    // Rotate the axis toward the other one, in the plane of both
+    const F turn = new_angle - angle;
+    const F keep = std::sin(between - turn) / sin_between;
+    const F take = std::sin(turn) / sin_between;
+    for (size_t i = 0; i < 3; ++i) {
+      cone_axis[i] = keep * cone_axis[i] + take * unit[i];
+    }
+    // Renormalized, against drift over many merges
+    const F axis_length =
+        std::sqrt(cone_axis[0] * cone_axis[0] + cone_axis[1] * cone_axis[1] +
+                  cone_axis[2] * cone_axis[2]);
+    for (size_t i = 0; i < 3; ++i) {
+      cone_axis[i] /= axis_length;
+    }
+    cone_cutoff = std::cos(new_angle);
+  }
+};
+
+/**
+A cluster of at most a few hundred triangles of a mesh, for mesh shaders and cluster culling
+*/
+template <typename F> struct Meshlet {
+  /// Range of `Mesh::meshlet_vertices` holding the mesh vertices it uses
+  uint32_t vertex_offset;
+  uint32_t vertex_count;
+  /// Range of `Mesh::meshlet_triangles`, in triangles: 3 local vertex indices each
+  uint32_t triangle_offset;
+  uint32_t triangle_count;
+  /// Bounding sphere
+  std::array<F, 3> center;
+  F radius;
+  /// All the triangle normals (following the winding) n have
+  /// dot(n, cone_axis) >= cone_cutoff. A cutoff of -1 means no useful cone
+  std::array<F, 3> cone_axis;
+  F cone_cutoff;
+};
+
+template <typename F> class MeshBvh;
+
 template <typename F> struct Mesh {
   std::vector<F> positions;
   std::vector<F> normals;
   std::vector<size_t> triangle_indices;
+  /// Filled by the extractor
+  MeshBounds<F> bounds;
+  /// Only filled when built, see `build_meshlets`
+  std::vector<Meshlet<F>> meshlets;
+  std::vector<uint32_t> meshlet_vertices;
+  std::vector<uint8_t> meshlet_triangles;
+  /// Only built on request, see `mesh_bvh.hpp`. Shared by the copies of the mesh
+  std::shared_ptr<const MeshBvh<F>> bvh;
 
   Mesh() = default;
   Mesh(const std::vector<F> &positions, const std::vector<F> &normals,
@@ -47,23 +287,39 @@ template <typename F> struct Mesh {
 
   size_t num_tris() const { return triangle_indices.size() / 3; }
 
+  /// Heap and inline memory held by the mesh, used for cache budgets
+  size_t memory_size() const {
+    return sizeof(*this) + positions.capacity() * sizeof(F) +
+           normals.capacity() * sizeof(F) +
+           triangle_indices.capacity() * sizeof(size_t) +
+           meshlets.capacity() * sizeof(Meshlet<F>) +
+           meshlet_vertices.capacity() * sizeof(uint32_t) +
+           meshlet_triangles.capacity() * sizeof(uint8_t) +
+           (bvh ? bvh->memory_size() : 0);
+  }
+
+  Triangle<F> triangle(size_t i) const {
+    const size_t i1 = triangle_indices[3 * i];
+    const size_t i2 = triangle_indices[3 * i + 1];
+    const size_t i3 = triangle_indices[3 * i + 2];
+    return Triangle<F>{{
+        Vertex<F>{
+            {positions[3 * i1], positions[3 * i1 + 1], positions[3 * i1 + 2]},
+            {normals[3 * i1], normals[3 * i1 + 1], normals[3 * i1 + 2]}},
+        Vertex<F>{
+            {positions[3 * i2], positions[3 * i2 + 1], positions[3 * i2 + 2]},
+            {normals[3 * i2], normals[3 * i2 + 1], normals[3 * i2 + 2]}},
+        Vertex<F>{
+            {positions[3 * i3], positions[3 * i3 + 1], positions[3 * i3 + 2]},
+            {normals[3 * i3], normals[3 * i3 + 1], normals[3 * i3 + 2]}},
+    }};
+  }
+
   std::vector<Triangle<F>> tris() const {
     std::vector<Triangle<F>> tris;
+    tris.reserve(num_tris());
     for (size_t i = 0; i < num_tris(); ++i) {
-      size_t i1 = triangle_indices[3 * i];
-      size_t i2 = triangle_indices[3 * i + 1];
-      size_t i3 = triangle_indices[3 * i + 2];
-      tris.push_back(Triangle<F>{{
-          Vertex<F>{
-              {positions[3 * i1], positions[3 * i1 + 1], positions[3 * i1 + 2]},
-              {normals[3 * i1], normals[3 * i1 + 1], normals[3 * i1 + 2]}},
-          Vertex<F>{
-              {positions[3 * i2], positions[3 * i2 + 1], positions[3 * i2 + 2]},
-              {normals[3 * i2], normals[3 * i2 + 1], normals[3 * i2 + 2]}},
-          Vertex<F>{
-              {positions[3 * i3], positions[3 * i3 + 1], positions[3 * i3 + 2]},
-              {normals[3 * i3], normals[3 * i3 + 1], normals[3 * i3 + 2]}},
-      }});
+      tris.push_back(triangle(i));
     }
     return tris;
   }
@@ -90,6 +346,75 @@ std::ostream &operator<<(std::ostream &os, const Mesh<F> &mesh) {
   return os;
 }
 
+/**
+A mesh whose vertices near the block border also carry a secondary position: the one they take when the
+block has a transition on all the sides in `border_sides`. This is the data needed to switch transition sides
+without re-extracting, as described in Lengyel's dissertation
+*/
+template <typename F> struct MeshWithSecondaryPositions {
+  Mesh<F> mesh;
+  /// 3 coordinates per vertex, equal to the primary position when the vertex does not move
+  std::vector<F> secondary_positions;
+  /// `TransitionSides` bits of the block faces the vertex is near, per vertex
+  std::vector<uint8_t> border_sides;
+
+  bool uses_secondary_position(size_t vertex, TransitionSides sides) const {
+    return border_sides[vertex] != 0 &&
+           (border_sides[vertex] & ~sides.to_ulong()) == 0;
+  }
+
+  /// The vertex positions to draw with, for a block with the given transition sides
+  std::vector<F> positions_for(TransitionSides sides) const {
+    std::vector<F> positions = mesh.positions;
+    for (size_t v = 0; v < border_sides.size(); ++v) {
+      if (uses_secondary_position(v, sides)) {
+        positions[3 * v] = secondary_positions[3 * v];
+        positions[3 * v + 1] = secondary_positions[3 * v + 1];
+        positions[3 * v + 2] = secondary_positions[3 * v + 2];
+      }
+    }
+    return positions;
+  }
+};
+
+/**
+The regular cells mesh, and one separate transition cells mesh per side (indexed by `TransitionSide`). Any
+transition sides can be obtained by drawing the transition meshes of these sides, with the positions they select
+*/
+template <typename F> struct LayeredMesh {
+  MeshWithSecondaryPositions<F> regular;
+  std::array<MeshWithSecondaryPositions<F>, 6> transitions;
+
+  /// Merges the parts needed for the given transition sides into a single mesh.
+  /// Only vertices in the cells along a block edge between a transition side and
+  /// a side without one can differ from `extract` with the same sides: here they
+  /// keep their primary position
+  Mesh<F> assemble(TransitionSides sides) const {
+    Mesh<F> result(regular.positions_for(sides), regular.mesh.normals,
+                   regular.mesh.triangle_indices);
+    result.bounds = regular.mesh.bounds;
+    for (size_t side = 0; side < transitions.size(); ++side) {
+      if (!sides.test(side)) {
+        continue;
+      }
+      const auto &transition = transitions[side];
+      const size_t first_vertex = result.positions.size() / 3;
+      const auto positions = transition.positions_for(sides);
+      result.positions.insert(result.positions.end(), positions.begin(),
+                              positions.end());
+      result.normals.insert(result.normals.end(),
+                            transition.mesh.normals.begin(),
+                            transition.mesh.normals.end());
+      for (size_t index : transition.mesh.triangle_indices) {
+        result.triangle_indices.push_back(first_vertex + index);
+      }
+      result.bounds.merge(transition.mesh.bounds);
+    }
+    result.bounds.shrink_sphere_to_box();
+    return result;
+  }
+};
+
 template <typename F> struct Position {
   F x, y, z;
 
@@ -11,25 +11,25 @@ inline Position<F> to_position_in_block(
     return position_in_block;
 }
 
-inline RegularVoxelIndex to_higher_res_neighbour_block_index(
+RegularVoxelIndex to_higher_res_neighbour_block_index(
     const HighResolutionVoxelIndex& self, std::size_t this_block_size)
 {
     auto higher_res_block_size = static_cast<size_t>(this_block_size) * 2;
     auto cell = self.cell;
     auto delta = self.delta;
     auto rot = Rotation::for_side(cell.side);
-    auto x = static_cast<int64_t>(higher_res_block_size) * (rot.uvw_base.x + rot.w.x)
+    auto x = static_cast<VoxelCoordinate>(higher_res_block_size) * (rot.uvw_base.x + rot.w.x)
         + delta.w * rot.w.x
-        + (2 * static_cast<int64_t>(cell.cell_u) + delta.u) * rot.u.x
-        + (2 * static_cast<int64_t>(cell.cell_v) + delta.v) * rot.v.x;
-    auto y = static_cast<int64_t>(higher_res_block_size) * (rot.uvw_base.y + rot.w.y)
+        + (2 * static_cast<VoxelCoordinate>(cell.cell_u) + delta.u) * rot.u.x
+        + (2 * static_cast<VoxelCoordinate>(cell.cell_v) + delta.v) * rot.v.x;
+    auto y = static_cast<VoxelCoordinate>(higher_res_block_size) * (rot.uvw_base.y + rot.w.y)
         + delta.w * rot.w.y
-        + (2 * static_cast<int64_t>(cell.cell_u) + delta.u) * rot.u.y
-        + (2 * static_cast<int64_t>(cell.cell_v) + delta.v) * rot.v.y;
-    auto z = static_cast<int64_t>(higher_res_block_size) * (rot.uvw_base.z + rot.w.z)
+        + (2 * static_cast<VoxelCoordinate>(cell.cell_u) + delta.u) * rot.u.y
+        + (2 * static_cast<VoxelCoordinate>(cell.cell_v) + delta.v) * rot.v.y;
+    auto z = static_cast<VoxelCoordinate>(higher_res_block_size) * (rot.uvw_base.z + rot.w.z)
         + delta.w * rot.w.z
-        + (2 * static_cast<int64_t>(cell.cell_u) + delta.u) * rot.u.z
-        + (2 * static_cast<int64_t>(cell.cell_v) + delta.v) * rot.v.z;
+        + (2 * static_cast<VoxelCoordinate>(cell.cell_u) + delta.u) * rot.u.z
+        + (2 * static_cast<VoxelCoordinate>(cell.cell_v) + delta.v) * rot.v.z;
     return RegularVoxelIndex { x, y, z };
 }
 
@@ -11,29 +11,51 @@
 
 struct Rotation;
 
+/// Coordinates of cells within a block
+using CellCoordinate = uint16_t;
+/// Coordinates of voxels within a block, or within the finer blocks across one of its sides. Signed for the
+/// voxels out of the block read for gradients
+using VoxelCoordinate = int32_t;
+
+/// Largest block subdivisions the coordinate types hold. Block sizes are converted to them at the extraction
+/// entry points, and voxel sources with a wider lattice of their own (`LatticeVoxelSource`) offset them in 64 bits
+constexpr size_t MAX_BLOCK_SUBDIVISIONS = 0xFFFF;
+
 struct RegularCellIndex {
-    std::size_t x;
-    std::size_t y;
-    std::size_t z;
+    CellCoordinate x;
+    CellCoordinate y;
+    CellCoordinate z;
 };
 
 struct RegularVoxelDelta {
-    int64_t  x;
-    int64_t  y;
-    int64_t  z;
+    VoxelCoordinate x;
+    VoxelCoordinate y;
+    VoxelCoordinate z;
 };
 
 struct RegularVoxelIndex {
-    int64_t  x;
-    int64_t  y;
-    int64_t  z;
+    VoxelCoordinate x;
+    VoxelCoordinate y;
+    VoxelCoordinate z;
 };
 
+inline RegularCellIndex to_cell_index(size_t x, size_t y, size_t z) {
+    return RegularCellIndex {
+        static_cast<CellCoordinate>(x), static_cast<CellCoordinate>(y), static_cast<CellCoordinate>(z)
+    };
+}
+
+inline RegularVoxelIndex to_voxel_index(int64_t x, int64_t y, int64_t z) {
+    return RegularVoxelIndex {
+        static_cast<VoxelCoordinate>(x), static_cast<VoxelCoordinate>(y), static_cast<VoxelCoordinate>(z)
+    };
+}
+
 inline RegularVoxelIndex operator+(const RegularCellIndex& lhs, const RegularVoxelDelta& rhs) {
     return RegularVoxelIndex {
-        static_cast<int64_t >(lhs.x) + rhs.x,
-        static_cast<int64_t >(lhs.y) + rhs.y,
-        static_cast<int64_t >(lhs.z) + rhs.z
+        lhs.x + rhs.x,
+        lhs.y + rhs.y,
+        lhs.z + rhs.z
     };
 }
 
@@ -48,29 +70,29 @@ inline RegularVoxelIndex operator+(const RegularVoxelIndex& lhs, const RegularVo
 
 struct TransitionCellIndex {
     TransitionSide side;
-    std::size_t cell_u;
-    std::size_t cell_v;
+    CellCoordinate cell_u;
+    CellCoordinate cell_v;
 };
 
 inline TransitionCellIndex from_transition_side(TransitionSide side, std::size_t cell_u, std::size_t cell_v) {
-    return TransitionCellIndex { side, cell_u, cell_v };
+    return TransitionCellIndex { side, static_cast<CellCoordinate>(cell_u), static_cast<CellCoordinate>(cell_v) };
 }
 
 struct HighResolutionVoxelDelta {
 
     HighResolutionVoxelDelta() = default;
 
-    HighResolutionVoxelDelta(const std::tuple<int64_t , int64_t , int64_t > &uvw) :
+    HighResolutionVoxelDelta(const std::tuple<VoxelCoordinate, VoxelCoordinate, VoxelCoordinate> &uvw) :
         u(std::get<0>(uvw)),
         v(std::get<1>(uvw)),
         w(std::get<2>(uvw)) {}
 
     /// U. From -1 to 3 (included). 0 to 2 are within the cell. -1 and 3 extend out, for gradient computations
-    int64_t  u;
+    VoxelCoordinate u;
     /// V. From -1 to 3 (included). 0 to 2 are within the cell. -1 and 3 extend out, for gradient computations
-    int64_t  v;
+    VoxelCoordinate v;
     /// W. From -1 to 1. 0 is on the face, 1 is within the cell, -1 is outside the cell
-    int64_t  w;
+    VoxelCoordinate w;
 };
 
 struct HighResolutionVoxelIndex {
@@ -79,7 +101,8 @@ struct HighResolutionVoxelIndex {
 };
 
 inline HighResolutionVoxelIndex from_transition_side(
-    TransitionSide side, std::size_t cell_u, std::size_t cell_v, int64_t  u, int64_t  v, int64_t  w)
+    TransitionSide side, std::size_t cell_u, std::size_t cell_v, VoxelCoordinate u, VoxelCoordinate v,
+    VoxelCoordinate w)
 {
     return HighResolutionVoxelIndex {
         .cell = from_transition_side(side, cell_u, cell_v),
@@ -98,10 +121,14 @@ RegularVoxelIndex as_regular_index(const HighResolutionVoxelIndex& voxelIndex, c
 
 inline Position<float> to_position_in_block(const Block<float>& block, const HighResolutionVoxelIndex& self);
 
-inline RegularVoxelIndex to_higher_res_neighbour_block_index(
+/**
+Index of a transition voxel in the lattice of the finer blocks across its side: twice the subdivisions of this
+block per block size, from the low corner of the space of this block's size filled by the finer blocks
+*/
+RegularVoxelIndex to_higher_res_neighbour_block_index(
     const HighResolutionVoxelIndex& self, std::size_t this_block_size);
 
-inline HighResolutionVoxelDelta from_high_res(uint64_t  u, uint64_t  v, uint64_t  w) {
+inline HighResolutionVoxelDelta from_high_res(VoxelCoordinate u, VoxelCoordinate v, VoxelCoordinate w) {
     return HighResolutionVoxelDelta({ u, v, w });
 }
 
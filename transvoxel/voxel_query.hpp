@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "density.hpp"
+#include "structs.hpp"
+#include "voxel_coordinates.hpp"
+
+// Point and ray queries straight on voxel densities, without a mesh: through a `PreCachingVoxelSource`, a
+// `DenseVoxelChunk`, or anything with `get_density(const RegularVoxelIndex&)`. A cache loaded with adaptive
+// sampling holds placeholders instead of densities far from the surfaces: queries and copies sample what is left
+// of its block voxels first, so they take it by non-const reference.
+
+/**
+Voxels that may not all be sampled yet, like the caches of `PreCachingVoxelSource`
+*/
+template <typename V>
+concept SampledOnDemand = requires(V& voxels) { voxels.sample_regular_block_voxels(); };
+
+/**
+Stored densities of the (subdivisions + 1)^3 voxels of a block, in X, then Y, then Z rows. Edits are seen by
+queries right away
+*/
+template <typename D>
+struct DenseVoxelChunk {
+    size_t subdivisions;
+    std::vector<D> densities;
+
+    DenseVoxelChunk(size_t subdivisions, D fill = D(0))
+        : subdivisions(subdivisions),
+          densities((subdivisions + 1) * (subdivisions + 1) * (subdivisions + 1), fill) {}
+
+    /**
+    Copies the block voxels of any voxel source
+    */
+    template <typename S>
+        requires (!SampledOnDemand<S>)
+    static DenseVoxelChunk from_source(const S& source, size_t subdivisions) {
+        return copy_of(source, subdivisions);
+    }
+
+    /**
+    Copies the block voxels of a cache, sampling the ones it has not yet
+    */
+    template <SampledOnDemand S>
+    static DenseVoxelChunk from_source(S& source, size_t subdivisions) {
+        source.sample_regular_block_voxels();
+        return copy_of(source, subdivisions);
+    }
+
+    D get_density(const RegularVoxelIndex& index) const {
+        return densities[storage_index(index)];
+    }
+
+    void set_density(const RegularVoxelIndex& index, D density) {
+        densities[storage_index(index)] = density;
+    }
+
+    size_t storage_index(const RegularVoxelIndex& index) const {
+        const size_t side = subdivisions + 1;
+        return side * side * static_cast<size_t>(index.x) + side * static_cast<size_t>(index.y)
+            + static_cast<size_t>(index.z);
+    }
+
+private:
+    template <typename S>
+    static DenseVoxelChunk copy_of(const S& source, size_t subdivisions) {
+        DenseVoxelChunk chunk(subdivisions);
+        const VoxelCoordinate subs = static_cast<VoxelCoordinate>(subdivisions);
+        for (VoxelCoordinate x = 0; x <= subs; ++x) {
+            for (VoxelCoordinate y = 0; y <= subs; ++y) {
+                for (VoxelCoordinate z = 0; z <= subs; ++z) {
+                    const RegularVoxelIndex index{ x, y, z };
+                    chunk.densities[chunk.storage_index(index)] = source.get_density(index);
+                }
+            }
+        }
+        return chunk;
+    }
+};
+
+template <typename F>
+struct VoxelRayHit {
+    std::array<F, 3> position;
+    /// Along the ray, in multiples of the direction given
+    F distance;
+    /// Pointing out of the solid, like mesh normals
+    std::array<float, 3> normal;
+};
+
+/**
+Queries in world coordinates over the voxels of a block, interpolating densities trilinearly between voxels.
+Only the block voxels are read (indices 0 to subdivisions): points outside of the block are clamped to it. The ones
+a cache has not sampled yet are sampled when the query is made
+*/
+template <typename F, typename V>
+class VoxelQuery {
+public:
+    VoxelQuery(const V& voxels, const Block<F>& block, float threshold = 0.0f)
+        requires (!SampledOnDemand<V>)
+        : voxels(voxels),
+          block(block),
+          threshold(threshold),
+          to_grid(static_cast<F>(block.subdivisions) / block.dims.size) {}
+
+    VoxelQuery(V& voxels, const Block<F>& block, float threshold = 0.0f)
+        requires SampledOnDemand<V>
+        : voxels(voxels),
+          block(block),
+          threshold(threshold),
+          to_grid(static_cast<F>(block.subdivisions) / block.dims.size) {
+        voxels.sample_regular_block_voxels();
+    }
+
+    float density(const std::array<F, 3>& position) const {
+        return density_in_grid(grid_position(position));
+    }
+
+    bool solid(const std::array<F, 3>& position) const {
+        return density(position) > threshold;
+    }
+
+    /**
+    Derivative of the interpolated density, per world unit
+    */
+    std::array<float, 3> gradient(const std::array<F, 3>& position) const {
+        const Corners corners = corners_around(grid_position(position));
+        const float* f = corners.fraction;
+        const float* v = corners.values;
+        // Differences along one axis, interpolated along the two others
+        const float dx = lerp(lerp(v[4] - v[0], v[5] - v[1], f[2]), lerp(v[6] - v[2], v[7] - v[3], f[2]), f[1]);
+        const float dy = lerp(lerp(v[2] - v[0], v[3] - v[1], f[2]), lerp(v[6] - v[4], v[7] - v[5], f[2]), f[0]);
+        const float dz = lerp(lerp(v[1] - v[0], v[3] - v[2], f[1]), lerp(v[5] - v[4], v[7] - v[6], f[1]), f[0]);
+        const float scale = static_cast<float>(to_grid);
+        return { dx * scale, dy * scale, dz * scale };
+    }
+
+    std::array<float, 3> normal(const std::array<F, 3>& position) const {
+        const auto g = gradient(position);
+        return Density<float>::to_normal(g[0], g[1], g[2]);
+    }
+
+    /**
+    First crossing of the surface along the ray, within `max_distance` (in multiples of `direction`). Walks the
+    voxel cells the ray goes through, and refines within the first one whose entry and exit are on different
+    sides of the surface. A surface entering and leaving a cell between two samples can be missed
+    */
+    std::optional<VoxelRayHit<F>> raycast(const std::array<F, 3>& origin, const std::array<F, 3>& direction,
+                                          F max_distance = std::numeric_limits<F>::max()) const {
+        const auto o = grid_position(origin);
+        std::array<F, 3> d;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            d[axis] = direction[axis] * to_grid;
+        }
+        // Clip to the block
+        const F high = static_cast<F>(block.subdivisions);
+        F t_enter = 0;
+        F t_exit = max_distance;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            if (d[axis] == 0) {
+                if (o[axis] < 0 || o[axis] > high) {
+                    return std::nullopt;
+                }
+                continue;
+            }
+            F t0 = (0 - o[axis]) / d[axis];
+            F t1 = (high - o[axis]) / d[axis];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            t_enter = std::max(t_enter, t0);
+            t_exit = std::min(t_exit, t1);
+        }
+        if (t_enter > t_exit) {
+            return std::nullopt;
+        }
+
+        // Amanatides and Woo traversal
+        std::array<VoxelCoordinate, 3> cell;
+        std::array<VoxelCoordinate, 3> step;
+        std::array<F, 3> t_next;
+        std::array<F, 3> t_delta;
+        const VoxelCoordinate last_cell = static_cast<VoxelCoordinate>(block.subdivisions) - 1;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            const F start = o[axis] + t_enter * d[axis];
+            cell[axis] = std::clamp<VoxelCoordinate>(static_cast<VoxelCoordinate>(std::floor(start)), 0, last_cell);
+            if (d[axis] > 0) {
+                step[axis] = 1;
+                t_next[axis] = (static_cast<F>(cell[axis] + 1) - o[axis]) / d[axis];
+                t_delta[axis] = 1 / d[axis];
+            } else if (d[axis] < 0) {
+                step[axis] = -1;
+                t_next[axis] = (static_cast<F>(cell[axis]) - o[axis]) / d[axis];
+                t_delta[axis] = -1 / d[axis];
+            } else {
+                step[axis] = 0;
+                t_next[axis] = std::numeric_limits<F>::max();
+                t_delta[axis] = std::numeric_limits<F>::max();
+            }
+        }
+        F t = t_enter;
+        float value = density_along(o, d, t) - threshold;
+        while (true) {
+            const size_t axis = t_next[0] < t_next[1]
+                ? (t_next[0] < t_next[2] ? 0 : 2)
+                : (t_next[1] < t_next[2] ? 1 : 2);
+            const F t_cell_exit = std::min(t_next[axis], t_exit);
+            const float exit_value = density_along(o, d, t_cell_exit) - threshold;
+            if ((value > 0) != (exit_value > 0)) {
+                return hit_between(origin, direction, o, d, t, value, t_cell_exit);
+            }
+            if (t_next[axis] >= t_exit) {
+                return std::nullopt;
+            }
+            cell[axis] += step[axis];
+            if (cell[axis] < 0 || cell[axis] > last_cell) {
+                return std::nullopt;
+            }
+            t = t_cell_exit;
+            value = exit_value;
+            t_next[axis] += t_delta[axis];
+        }
+    }
+
+private:
+    struct Corners {
+        /// Indexed by 4 * dx + 2 * dy + dz
+        float values[8];
+        float fraction[3];
+    };
+
+    static float lerp(float a, float b, float t) {
+        return a + t * (b - a);
+    }
+
+    std::array<F, 3> grid_position(const std::array<F, 3>& position) const {
+        std::array<F, 3> grid;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            grid[axis] = (position[axis] - block.dims.base[axis]) * to_grid;
+        }
+        return grid;
+    }
+
+    Corners corners_around(const std::array<F, 3>& grid) const {
+        Corners corners;
+        VoxelCoordinate cell[3];
+        const VoxelCoordinate last_cell = static_cast<VoxelCoordinate>(block.subdivisions) - 1;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            const F clamped = std::clamp<F>(grid[axis], 0, static_cast<F>(block.subdivisions));
+            cell[axis] = std::min(static_cast<VoxelCoordinate>(std::floor(clamped)), last_cell);
+            corners.fraction[axis] = static_cast<float>(clamped - static_cast<F>(cell[axis]));
+        }
+        for (VoxelCoordinate corner = 0; corner < 8; ++corner) {
+            const RegularVoxelIndex index{ cell[0] + (corner >> 2), cell[1] + ((corner >> 1) & 1),
+                                           cell[2] + (corner & 1) };
+            corners.values[corner] = static_cast<float>(voxels.get_density(index));
+        }
+        return corners;
+    }
+
+    float density_in_grid(const std::array<F, 3>& grid) const {
+        const Corners corners = corners_around(grid);
+        const float* f = corners.fraction;
+        const float* v = corners.values;
+        const float x0 = lerp(lerp(v[0], v[1], f[2]), lerp(v[2], v[3], f[2]), f[1]);
+        const float x1 = lerp(lerp(v[4], v[5], f[2]), lerp(v[6], v[7], f[2]), f[1]);
+        return lerp(x0, x1, f[0]);
+    }
+
+    float density_along(const std::array<F, 3>& o, const std::array<F, 3>& d, F t) const {
+        return density_in_grid({ o[0] + t * d[0], o[1] + t * d[1], o[2] + t * d[2] });
+    }
+
+    /**
+    Bisection between a point at `t_low` (density minus threshold `value_low`) and one on the other side
+    */
+    VoxelRayHit<F> hit_between(const std::array<F, 3>& origin, const std::array<F, 3>& direction,
+                               const std::array<F, 3>& o, const std::array<F, 3>& d,
+                               F t_low, float value_low, F t_high) const {
+        constexpr int ITERATIONS = 16;
+        for (int i = 0; i < ITERATIONS; ++i) {
+            const F t_middle = (t_low + t_high) / 2;
+            const float value_middle = density_along(o, d, t_middle) - threshold;
+            if ((value_middle > 0) == (value_low > 0)) {
+                t_low = t_middle;
+                value_low = value_middle;
+            } else {
+                t_high = t_middle;
+            }
+        }
+        const F t = (t_low + t_high) / 2;
+        VoxelRayHit<F> hit;
+        hit.distance = t;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            hit.position[axis] = origin[axis] + t * direction[axis];
+        }
+        hit.normal = normal(hit.position);
+        return hit;
+    }
+
+    const V& voxels;
+    Block<F> block;
+    float threshold;
+    F to_grid;
+};
@@ -1,5 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include "density.hpp"
 #include "structs.hpp"
 #include "voxel_coordinates.hpp"
@@ -10,19 +19,82 @@ class VoxelSource {
 public:
     virtual D get_density(const RegularVoxelIndex& voxel_index) const = 0;
     virtual D get_transition_density(const HighResolutionVoxelIndex& index) const= 0;
+
+    /**
+    Densities of `count` voxels in a row along Z, starting at `start`
+    */
+    virtual void get_density_row(const RegularVoxelIndex& start, size_t count, D* densities) const {
+        for (size_t i = 0; i < count; ++i) {
+            densities[i] = get_density(RegularVoxelIndex{ start.x, start.y, start.z + static_cast<VoxelCoordinate>(i) });
+        }
+    }
+
     virtual ~VoxelSource() {}
 };
 
 template <typename C, typename D, typename SF>
 class WorldMappingVoxelSource : public VoxelSource<D> {
 public:
-    WorldMappingVoxelSource(const SF &field, const Block<C> &block) : field(field), block(block) {}
+    WorldMappingVoxelSource(const SF &field, const Block<C> &block) : field(field), block(block) {
+        if constexpr (requires { this->field.restrict_to(block.dims.base, block.dims.base); }) {
+            const auto [low, high] = sampled_region();
+            this->field.restrict_to(low, high);
+        }
+    }
+
+    /**
+    The block, grown by one cell for the voxels sampled out of it (gradients)
+    */
+    std::pair<std::array<C, 3>, std::array<C, 3>> sampled_region() const {
+        const C cell_size = block.dims.size * Coordinate<C>::from_ratio(1, block.subdivisions);
+        std::array<C, 3> low;
+        std::array<C, 3> high;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            low[axis] = block.dims.base[axis] - cell_size;
+            high[axis] = block.dims.base[axis] + block.dims.size + cell_size;
+        }
+        return { low, high };
+    }
+
+    /**
+    Bounds of the densities of the voxels from `low` to `high` included, if the field can tell
+    */
+    std::optional<DensityBounds<D>> region_density_bounds(const RegularVoxelIndex& low,
+                                                          const RegularVoxelIndex& high) const {
+        if constexpr (requires { field.density_bounds(block.dims.base, block.dims.base); }) {
+            return field.density_bounds(position_of(low), position_of(high));
+        } else {
+            return std::nullopt;
+        }
+    }
 
     D get_density(const RegularVoxelIndex& voxel_index) const override {
-        C x = block.dims.base[0] + block.dims.size * Coordinate<C>::from_ratio(voxel_index.x, block.subdivisions);
-        C y = block.dims.base[1] + block.dims.size * Coordinate<C>::from_ratio(voxel_index.y, block.subdivisions);
-        C z = block.dims.base[2] + block.dims.size * Coordinate<C>::from_ratio(voxel_index.z, block.subdivisions);
-        return field.get_density(x, y, z);
+        const auto position = position_of(voxel_index);
+        return field.get_density(position[0], position[1], position[2]);
+    }
+
+    void get_density_row(const RegularVoxelIndex& start, size_t count, D* densities) const override {
+        if constexpr (requires { field.get_densities(nullptr, nullptr, nullptr, densities, count); }) {
+            // Hand the field chunks of points, so it can use its batch evaluation
+            constexpr size_t CHUNK = 64;
+            C xs[CHUNK];
+            C ys[CHUNK];
+            C zs[CHUNK];
+            const C x = block.dims.base[0] + block.dims.size * Coordinate<C>::from_ratio(start.x, block.subdivisions);
+            const C y = block.dims.base[1] + block.dims.size * Coordinate<C>::from_ratio(start.y, block.subdivisions);
+            for (size_t chunk_start = 0; chunk_start < count; chunk_start += CHUNK) {
+                const size_t chunk_size = std::min(CHUNK, count - chunk_start);
+                for (size_t i = 0; i < chunk_size; ++i) {
+                    const int64_t z_index = start.z + static_cast<int64_t>(chunk_start + i);
+                    xs[i] = x;
+                    ys[i] = y;
+                    zs[i] = block.dims.base[2] + block.dims.size * Coordinate<C>::from_ratio(z_index, block.subdivisions);
+                }
+                field.get_densities(xs, ys, zs, densities + chunk_start, chunk_size);
+            }
+        } else {
+            VoxelSource<D>::get_density_row(start, count, densities);
+        }
     }
 
     D get_transition_density(const HighResolutionVoxelIndex& index) const override {
@@ -36,10 +108,161 @@ public:
 
 private:
 
+    std::array<C, 3> position_of(const RegularVoxelIndex& voxel_index) const {
+        return {
+            block.dims.base[0] + block.dims.size * Coordinate<C>::from_ratio(voxel_index.x, block.subdivisions),
+            block.dims.base[1] + block.dims.size * Coordinate<C>::from_ratio(voxel_index.y, block.subdivisions),
+            block.dims.base[2] + block.dims.size * Coordinate<C>::from_ratio(voxel_index.z, block.subdivisions),
+        };
+    }
+
     SF field;
     Block<C> block;
 };
 
+template <typename C, typename D, typename SF>
+struct FieldThreading<WorldMappingVoxelSource<C, D, SF>> {
+    static constexpr bool thread_safe() {
+        return FieldThreading<SF>::thread_safe();
+    }
+};
+
+/**
+Densities of a box of voxels shared by the blocks of a batch extraction, each voxel sampled once on first use.
+Indices are global: block voxel 0 of the block at block coordinates (i, j, k) is (i, j, k) * subdivisions
+*/
+template <typename D>
+struct VoxelLattice {
+    std::array<int64_t, 3> low;
+    std::array<size_t, 3> dims;
+    std::vector<D> densities;
+    /// One byte per voxel rather than bits, so that concurrent loads of distinct voxels do not race
+    std::vector<uint8_t> sampled;
+
+    VoxelLattice(const std::array<int64_t, 3>& low, const std::array<int64_t, 3>& high)
+        : low(low),
+          dims{ static_cast<size_t>(high[0] - low[0] + 1), static_cast<size_t>(high[1] - low[1] + 1),
+                static_cast<size_t>(high[2] - low[2] + 1) },
+          densities(dims[0] * dims[1] * dims[2]),
+          sampled(dims[0] * dims[1] * dims[2], 0) {}
+
+    size_t index(int64_t x, int64_t y, int64_t z) const {
+        assert(x >= low[0] && y >= low[1] && z >= low[2]);
+        const size_t lx = static_cast<size_t>(x - low[0]);
+        const size_t ly = static_cast<size_t>(y - low[1]);
+        const size_t lz = static_cast<size_t>(z - low[2]);
+        assert(lx < dims[0] && ly < dims[1] && lz < dims[2]);
+        return dims[1] * dims[2] * lx + dims[2] * ly + lz;
+    }
+};
+
+/**
+Source of one block of a batch, reading its voxels from a `VoxelLattice` and sampling the missing ones through
+its own `WorldMappingVoxelSource`. Transition voxels, at half the cell size, are not shared
+*/
+template <typename C, typename D, typename SF>
+class LatticeVoxelSource : public VoxelSource<D> {
+public:
+    LatticeVoxelSource(const SF& field, const Block<C>& block, VoxelLattice<D>& lattice,
+                       const std::array<int64_t, 3>& offset)
+        : block_source(field, block), lattice(&lattice), offset(offset) {}
+
+    std::optional<DensityBounds<D>> region_density_bounds(const RegularVoxelIndex& low,
+                                                          const RegularVoxelIndex& high) const {
+        return block_source.region_density_bounds(low, high);
+    }
+
+    D get_density(const RegularVoxelIndex& voxel_index) const override {
+        const size_t index = lattice->index(offset[0] + voxel_index.x, offset[1] + voxel_index.y,
+                                            offset[2] + voxel_index.z);
+        if (!lattice->sampled[index]) {
+            lattice->densities[index] = block_source.get_density(voxel_index);
+            lattice->sampled[index] = 1;
+        }
+        return lattice->densities[index];
+    }
+
+    void get_density_row(const RegularVoxelIndex& start, size_t count, D* densities) const override {
+        const size_t first = lattice->index(offset[0] + start.x, offset[1] + start.y, offset[2] + start.z);
+        // Runs of voxels not sampled yet go to the block source together, for its batch path
+        size_t i = 0;
+        while (i < count) {
+            if (lattice->sampled[first + i]) {
+                densities[i] = lattice->densities[first + i];
+                ++i;
+                continue;
+            }
+            size_t run_end = i + 1;
+            while (run_end < count && !lattice->sampled[first + run_end]) {
+                ++run_end;
+            }
+            const RegularVoxelIndex run_start{ start.x, start.y, start.z + static_cast<VoxelCoordinate>(i) };
+            block_source.get_density_row(run_start, run_end - i, densities + i);
+            for (size_t j = i; j < run_end; ++j) {
+                lattice->densities[first + j] = densities[j];
+                lattice->sampled[first + j] = 1;
+            }
+            i = run_end;
+        }
+    }
+
+    D get_transition_density(const HighResolutionVoxelIndex& index) const override {
+        return block_source.get_transition_density(index);
+    }
+
+private:
+    WorldMappingVoxelSource<C, D, SF> block_source;
+    VoxelLattice<D>* lattice;
+    /// Global index of the block voxel 0
+    std::array<int64_t, 3> offset;
+};
+
+template <typename C, typename D, typename SF>
+struct FieldThreading<LatticeVoxelSource<C, D, SF>> {
+    static constexpr bool thread_safe() {
+        return FieldThreading<SF>::thread_safe();
+    }
+};
+
+/**
+Densities already sampled by the finer blocks across one side of a block, for its transition cells. Indexed as
+given by `to_higher_res_neighbour_block_index`. Only voxels on the shared face are read
+*/
+template <typename D>
+class NeighbourVoxelSource {
+public:
+    virtual D get_density(const RegularVoxelIndex& index) const = 0;
+
+    virtual ~NeighbourVoxelSource() {}
+};
+
+/**
+The 2x2x2 finer blocks filling the space of one block, each one a store of its own voxels with
+`get_density(const RegularVoxelIndex&)`: a `DenseVoxelChunk`, a loaded `PreCachingVoxelSource`... Stores are
+indexed by 4 * x + 2 * y + z, x, y and z being 0 or 1, and may be null if no face voxel falls in them
+*/
+template <typename D, typename V>
+class FinerBlocksVoxels : public NeighbourVoxelSource<D> {
+public:
+    FinerBlocksVoxels(const std::array<const V*, 8>& blocks, size_t subdivisions)
+        : blocks(blocks), subdivisions(static_cast<VoxelCoordinate>(subdivisions)) {}
+
+    D get_density(const RegularVoxelIndex& index) const override {
+        // Voxels on the boundary between two finer blocks are in both: take the lower one
+        const VoxelCoordinate bx = std::min<VoxelCoordinate>(index.x / subdivisions, 1);
+        const VoxelCoordinate by = std::min<VoxelCoordinate>(index.y / subdivisions, 1);
+        const VoxelCoordinate bz = std::min<VoxelCoordinate>(index.z / subdivisions, 1);
+        const V* block = blocks[4 * bx + 2 * by + bz];
+        assert(block != nullptr);
+        return block->get_density(RegularVoxelIndex{
+            index.x - bx * subdivisions, index.y - by * subdivisions, index.z - bz * subdivisions });
+    }
+
+private:
+    std::array<const V*, 8> blocks;
+    VoxelCoordinate subdivisions;
+};
+
 template <typename D, typename F>
 class VoxelSourceRef : public VoxelSource<D> {
 public:
@@ -0,0 +1,571 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "extraction.hpp"
+#include "extraction_queue.hpp"
+
+// Keeps the blocks around moving viewers extracted: an octree of levels of detail, transition sides where a block
+// faces finer ones, extractions on an `ExtractionQueue`, and eviction under a memory budget.
+
+/**
+A point the world is streamed around. The velocity, in world units per second, extends the wanted blocks ahead
+*/
+template <typename F>
+struct StreamingViewer {
+    std::array<F, 3> position;
+    std::array<F, 3> velocity;
+};
+
+template <typename F>
+struct StreamingSettings {
+    /// Lowest `lod_distance_factor`. The parent of a leaf got split, so a viewer is closer to it than the factor
+    /// times its size, and so closer than the factor plus sqrt(3) times its size to any block the leaf touches. With
+    /// a factor of at least sqrt(3), a touching block twice the size of the parent splits too: blocks across are
+    /// never more than one level apart, which the transition sides rely on. Rounded up, for the rounding of the
+    /// distances
+    static constexpr F MIN_LOD_DISTANCE_FACTOR = F(1.75);
+
+    /// World size of the finest blocks. Each coarser level of detail doubles it
+    F block_size = 16;
+    size_t subdivisions = 16;
+    size_t lod_levels = 4;
+    /// A block is split into 8 finer ones when a viewer is closer than this many times its size. At least
+    /// `MIN_LOD_DISTANCE_FACTOR`
+    F lod_distance_factor = 2;
+    /// Blocks farther than this from every viewer are not wanted
+    F view_distance = 256;
+    /// Seconds of viewer motion the wanted blocks also cover
+    F prefetch_time = 1;
+    /// Bytes of the meshes of the resident blocks, and of the voxels kept for them or loaded by their extractions
+    size_t memory_budget = size_t(256) << 20;
+    /// Finished extractions taken per `update`, nearest first. The others wait for the next updates
+    size_t max_completions_per_update = 8;
+    /// Extractions queued or running at once
+    size_t max_in_flight = 32;
+    size_t workers = std::thread::hardware_concurrency();
+    /// Keep the voxels of resident blocks, so that a change of transition sides re-extracts without sampling
+    bool keep_voxels = true;
+};
+
+/**
+A block of the streamed octree: its level of detail, and its position in blocks of that level
+*/
+struct StreamingBlockKey {
+    uint32_t level;
+    std::array<int64_t, 3> position;
+
+    bool operator==(const StreamingBlockKey& other) const = default;
+};
+
+struct StreamingBlockKeyHash {
+    size_t operator()(const StreamingBlockKey& key) const {
+        size_t h = std::hash<uint32_t>()(key.level);
+        for (const int64_t coordinate : key.position) {
+            h ^= std::hash<int64_t>()(coordinate) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+};
+
+struct StreamingStats {
+    size_t wanted_blocks = 0;
+    /// Blocks with a mesh, wanted or kept until the budget needs their memory
+    size_t resident_blocks = 0;
+    /// Wanted blocks without a mesh yet
+    size_t missing_blocks = 0;
+    /// Extractions waiting for a worker
+    size_t queued = 0;
+    /// Extractions queued, running, or finished and not taken yet
+    size_t in_flight = 0;
+    size_t completed = 0;
+    size_t completed_last_update = 0;
+    size_t evictions = 0;
+    /// Kept voxels, and a bound of the voxels of the extractions in flight
+    size_t voxel_bytes = 0;
+    size_t mesh_bytes = 0;
+    /// From submission to the `update` taking the mesh
+    double total_latency_ms = 0;
+    double max_latency_ms = 0;
+
+    double mean_latency_ms() const {
+        return completed == 0 ? 0.0 : total_latency_ms / static_cast<double>(completed);
+    }
+};
+
+/**
+Streams the surface of a field around viewers. Each `update` (typically once per frame) works out the wanted
+blocks, queues their extractions nearest first, takes a bounded number of finished ones, and evicts blocks, the
+ones not wanted first and the farthest first, to stay within the memory budget. New extractions are only queued
+while the wanted blocks leave room for them, at their average size, dropping the voxels kept for the farthest
+blocks if need be. Not thread safe: `update` and the visits belong to one thread, the extractions run on the
+workers
+*/
+template <typename F, typename D, typename SF>
+class WorldStreamer {
+public:
+    using Key = StreamingBlockKey;
+    using Source = WorldMappingVoxelSource<F, D, SF>;
+    using VoxelCache = PreCachingVoxelSource<D, Source>;
+
+    WorldStreamer(SF field, D threshold, const StreamingSettings<F>& settings, const ExtractionOptions& options = {})
+        : field(std::move(field)),
+          threshold(threshold),
+          settings(settings),
+          options(options),
+          blocks(),
+          statistics(),
+          voxel_cache_bytes(VoxelCache::max_memory_size(settings.subdivisions, options.cache_layout)),
+          queue(settings.workers, options) {
+        assert(settings.lod_levels > 0 && settings.lod_levels <= 32);
+        assert(settings.lod_distance_factor >= StreamingSettings<F>::MIN_LOD_DISTANCE_FACTOR);
+    }
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    void update(std::span<const StreamingViewer<F>> viewers) {
+        const auto wanted = wanted_blocks(viewers);
+        for (auto it = blocks.begin(); it != blocks.end();) {
+            Entry& entry = it->second;
+            const auto found = wanted.find(it->first);
+            entry.wanted = found != wanted.end();
+            if (entry.wanted) {
+                entry.distance = found->second.distance;
+                entry.wanted_sides = found->second.sides;
+            } else {
+                entry.distance = viewer_distance(entry.block, viewers);
+            }
+            if (entry.job && (!entry.wanted || entry.job->sides != entry.wanted_sides)) {
+                queue.cancel(entry.job->job);
+                entry.job.reset();
+                // The cancelled extraction soon lets go of voxels that are not kept
+                if (!entry.voxels) {
+                    entry.voxel_bytes = 0;
+                }
+            } else if (entry.job) {
+                queue.reprioritize(entry.job->job, static_cast<float>(entry.distance));
+            }
+            if (!entry.wanted && !entry.has_mesh() && !entry.job) {
+                it = blocks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (const auto& [key, block] : wanted) {
+            if (blocks.find(key) == blocks.end()) {
+                Entry entry;
+                entry.block = block_of(key);
+                entry.wanted = true;
+                entry.distance = block.distance;
+                entry.wanted_sides = block.sides;
+                blocks.emplace(key, std::move(entry));
+            }
+        }
+        take_completed();
+        submit_wanted();
+        evict();
+        update_statistics(wanted.size());
+    }
+
+    /**
+    Calls `visit(block, mesh, sides)` for the wanted blocks with a mesh, extracted with transition `sides`. A block
+    whose transition sides changed keeps its previous mesh until the new one is taken; a wanted block without any
+    mesh yet is a hole
+    */
+    template <typename Visit>
+    void for_each_visible(const Visit& visit) const {
+        for (const auto& [key, entry] : blocks) {
+            if (entry.wanted && entry.has_mesh()) {
+                visit(entry.block, *entry.mesh.get(), entry.mesh_sides);
+            }
+        }
+    }
+
+    StreamingStats stats() const {
+        return statistics;
+    }
+
+    /**
+    World size of the blocks of a level of detail
+    */
+    F block_size(uint32_t level) const {
+        return settings.block_size * static_cast<F>(uint64_t(1) << level);
+    }
+
+private:
+    struct WantedBlock {
+        F distance;
+        TransitionSides sides;
+    };
+
+    struct InFlight {
+        ExtractionJob<F> job;
+        TransitionSides sides;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    struct Entry {
+        Block<F> block = Block<F>({ F(0), F(0), F(0) }, F(1), 1);
+        bool wanted = false;
+        /// To the nearest viewer, where it is now, wanted or not: the order of the extractions and of the evictions
+        F distance = 0;
+        TransitionSides wanted_sides;
+        /// Result of the last extraction taken, which holds the mesh: shared with the job rather than copied
+        std::shared_future<std::optional<Mesh<F>>> mesh;
+        TransitionSides mesh_sides;
+        size_t mesh_bytes = 0;
+        /// Null when the voxels are not kept
+        std::shared_ptr<VoxelCache> voxels;
+        /// Of the kept voxels, or while an extraction is in flight, the most its voxels can take
+        size_t voxel_bytes = 0;
+        std::optional<InFlight> job;
+
+        bool has_mesh() const {
+            return mesh.valid();
+        }
+    };
+
+    Block<F> block_of(const Key& key) const {
+        const F size = block_size(key.level);
+        return Block<F>({ static_cast<F>(key.position[0]) * size, static_cast<F>(key.position[1]) * size,
+                          static_cast<F>(key.position[2]) * size }, size, settings.subdivisions);
+    }
+
+    static F box_point_distance(const Block<F>& block, const std::array<F, 3>& point) {
+        F squared = 0;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            const F low = block.dims.base[axis];
+            const F high = low + block.dims.size;
+            const F outside = std::max({ low - point[axis], point[axis] - high, F(0) });
+            squared += outside * outside;
+        }
+        return std::sqrt(squared);
+    }
+
+    /**
+    From the block to the path of the viewer over the prefetch time. The distance is convex along the path
+    */
+    F box_path_distance(const Block<F>& block, const StreamingViewer<F>& viewer) const {
+        const auto at = [&](F t) {
+            std::array<F, 3> point;
+            for (size_t axis = 0; axis < 3; ++axis) {
+                point[axis] = viewer.position[axis] + viewer.velocity[axis] * settings.prefetch_time * t;
+            }
+            return box_point_distance(block, point);
+        };
+        F low = 0;
+        F high = 1;
+        for (size_t i = 0; i < 24; ++i) {
+            const F a = low + (high - low) / 3;
+            const F b = high - (high - low) / 3;
+            if (at(a) < at(b)) {
+                high = b;
+            } else {
+                low = a;
+            }
+        }
+        return std::min({ at(0), at(1), at((low + high) / 2) });
+    }
+
+    static F viewer_distance(const Block<F>& block, std::span<const StreamingViewer<F>> viewers) {
+        F distance = std::numeric_limits<F>::max();
+        for (const auto& viewer : viewers) {
+            distance = std::min(distance, box_point_distance(block, viewer.position));
+        }
+        return distance;
+    }
+
+    F path_distance(const Block<F>& block, std::span<const StreamingViewer<F>> viewers) const {
+        F distance = std::numeric_limits<F>::max();
+        for (const auto& viewer : viewers) {
+            distance = std::min(distance, box_path_distance(block, viewer));
+        }
+        return distance;
+    }
+
+    bool should_split(const Key& key, std::span<const StreamingViewer<F>> viewers) const {
+        return key.level > 0
+            && path_distance(block_of(key), viewers) < settings.lod_distance_factor * block_size(key.level);
+    }
+
+    /**
+    The leaves of the octree around the viewers. A block gets a transition side where the block of its level
+    across is split: finer blocks are on the other side. Blocks across are never more than one level apart (see
+    `StreamingSettings::MIN_LOD_DISTANCE_FACTOR`)
+    */
+    std::unordered_map<Key, WantedBlock, StreamingBlockKeyHash> wanted_blocks(
+        std::span<const StreamingViewer<F>> viewers) const {
+        std::unordered_map<Key, WantedBlock, StreamingBlockKeyHash> wanted;
+        const uint32_t top = static_cast<uint32_t>(settings.lod_levels - 1);
+        const F top_size = block_size(top);
+        std::unordered_set<Key, StreamingBlockKeyHash> roots;
+        for (const auto& viewer : viewers) {
+            int64_t low[3];
+            int64_t high[3];
+            for (size_t axis = 0; axis < 3; ++axis) {
+                const F ahead = viewer.position[axis] + viewer.velocity[axis] * settings.prefetch_time;
+                const F min = std::min(viewer.position[axis], ahead) - settings.view_distance;
+                const F max = std::max(viewer.position[axis], ahead) + settings.view_distance;
+                low[axis] = static_cast<int64_t>(std::floor(min / top_size));
+                high[axis] = static_cast<int64_t>(std::floor(max / top_size));
+            }
+            for (int64_t x = low[0]; x <= high[0]; ++x) {
+                for (int64_t y = low[1]; y <= high[1]; ++y) {
+                    for (int64_t z = low[2]; z <= high[2]; ++z) {
+                        roots.insert(Key{ top, { x, y, z } });
+                    }
+                }
+            }
+        }
+        std::vector<Key> pending(roots.begin(), roots.end());
+        while (!pending.empty()) {
+            const Key key = pending.back();
+            pending.pop_back();
+            const Block<F> block = block_of(key);
+            if (path_distance(block, viewers) > settings.view_distance) {
+                continue;
+            }
+            if (should_split(key, viewers)) {
+                for (int64_t child = 0; child < 8; ++child) {
+                    pending.push_back(Key{ key.level - 1, {
+                        2 * key.position[0] + (child >> 2), 2 * key.position[1] + ((child >> 1) & 1),
+                        2 * key.position[2] + (child & 1)
+                    } });
+                }
+                continue;
+            }
+            WantedBlock leaf{ viewer_distance(block, viewers), no_side() };
+            for (size_t side = 0; side < 6; ++side) {
+                Key across = key;
+                across.position[side / 2] += side % 2 == 0 ? -1 : 1;
+                if (should_split(across, viewers)) {
+                    leaf.sides.set(side);
+                }
+            }
+            wanted.emplace(key, leaf);
+        }
+        return wanted;
+    }
+
+    void take_completed() {
+        std::vector<Entry*> ready;
+        for (auto& [key, entry] : blocks) {
+            if (entry.job && entry.job->job.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                ready.push_back(&entry);
+            }
+        }
+        std::sort(ready.begin(), ready.end(), [](const Entry* a, const Entry* b) {
+            return a->distance < b->distance;
+        });
+        ready.resize(std::min(ready.size(), settings.max_completions_per_update));
+        statistics.completed_last_update = 0;
+        const auto now = std::chrono::steady_clock::now();
+        for (Entry* entry : ready) {
+            const InFlight job = std::move(*entry->job);
+            entry->job.reset();
+            entry->voxel_bytes = entry->voxels ? entry->voxels->memory_size() : 0;
+            if (!job.job.result.get()) {
+                continue;
+            }
+            entry->mesh = job.job.result;
+            entry->mesh_sides = job.sides;
+            entry->mesh_bytes = entry->mesh.get()->memory_size();
+            const double latency = std::chrono::duration<double, std::milli>(now - job.submitted).count();
+            statistics.total_latency_ms += latency;
+            statistics.max_latency_ms = std::max(statistics.max_latency_ms, latency);
+            ++statistics.completed;
+            ++statistics.completed_last_update;
+        }
+    }
+
+    void submit_wanted() {
+        std::vector<Entry*> missing;
+        // Kept voxels of wanted blocks, which extractions can have instead
+        std::vector<Entry*> reclaimable;
+        size_t in_flight = 0;
+        // Of the wanted blocks only: `evict` makes room by dropping the others
+        size_t resident = 0;
+        size_t resident_mesh_bytes = 0;
+        size_t new_in_flight = 0;
+        size_t bytes = 0;
+        for (auto& [key, entry] : blocks) {
+            in_flight += entry.job ? 1 : 0;
+            if (!entry.wanted) {
+                continue;
+            }
+            bytes += entry.mesh_bytes + entry.voxel_bytes;
+            if (entry.has_mesh()) {
+                ++resident;
+                resident_mesh_bytes += entry.mesh_bytes;
+            } else if (entry.job) {
+                ++new_in_flight;
+            }
+            if (!entry.job && (!entry.has_mesh() || entry.mesh_sides != entry.wanted_sides)) {
+                missing.push_back(&entry);
+            }
+            // A running extraction holds on to its voxels until it is done: dropping them frees nothing yet
+            if (entry.voxels && !entry.job) {
+                reclaimable.push_back(&entry);
+            }
+        }
+        std::sort(missing.begin(), missing.end(), [](const Entry* a, const Entry* b) {
+            return a->distance < b->distance;
+        });
+        // Nearest first, to drop from the back
+        std::sort(reclaimable.begin(), reclaimable.end(), [](const Entry* a, const Entry* b) {
+            return a->distance < b->distance;
+        });
+        // Meshes to come are counted at the average size
+        const size_t average_mesh_bytes = resident == 0 ? 0 : resident_mesh_bytes / resident;
+        bytes += new_in_flight * average_mesh_bytes;
+        for (Entry* entry : missing) {
+            if (in_flight >= settings.max_in_flight) {
+                break;
+            }
+            // The voxels the extraction may load, and the mesh of a new block. Re-extractions of resident blocks
+            // replace their mesh
+            size_t added = voxel_cache_bytes - std::min(voxel_cache_bytes, entry->voxel_bytes) +
+                           (entry->has_mesh() ? 0 : average_mesh_bytes);
+            // Missing meshes come before kept voxels: drop those of the farthest blocks to make room
+            while (bytes + added > settings.memory_budget && !reclaimable.empty()) {
+                Entry* kept = reclaimable.back();
+                reclaimable.pop_back();
+                if (kept == entry || kept->job || !kept->voxels) {
+                    continue;
+                }
+                bytes -= kept->voxel_bytes;
+                kept->voxels.reset();
+                kept->voxel_bytes = 0;
+            }
+            if (bytes + added > settings.memory_budget) {
+                break;
+            }
+            submit(*entry);
+            bytes += added;
+            ++in_flight;
+        }
+    }
+
+    void submit(Entry& entry) {
+        std::shared_ptr<VoxelCache> voxels = entry.voxels;
+        if (!voxels) {
+            voxels = make_voxel_cache<D>(Source(field, entry.block), entry.block, options);
+        }
+        if (settings.keep_voxels) {
+            entry.voxels = voxels;
+        }
+        // Until the extraction is done and the voxels can be measured
+        entry.voxel_bytes = std::max(entry.voxel_bytes, voxel_cache_bytes);
+        const Block<F> block = entry.block;
+        const D level = threshold;
+        const TransitionSides sides = entry.wanted_sides;
+        auto job = queue.submit_task([voxels, block, level, sides](const ExtractionOptions& job_options) {
+            return extract(voxels, block, level, sides, job_options);
+        }, static_cast<float>(entry.distance));
+        entry.job = InFlight{ std::move(job), sides, std::chrono::steady_clock::now() };
+    }
+
+    /**
+    Frees memory until within the budget: first the blocks not wanted, then the voxels kept for wanted blocks,
+    then the wanted blocks, each time the farthest first
+    */
+    void evict() {
+        size_t bytes = 0;
+        for (const auto& [key, entry] : blocks) {
+            bytes += entry.mesh_bytes + entry.voxel_bytes;
+        }
+        if (bytes <= settings.memory_budget) {
+            return;
+        }
+        std::vector<std::pair<Key, Entry*>> candidates;
+        for (auto& [key, entry] : blocks) {
+            candidates.emplace_back(key, &entry);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+            if (a.second->wanted != b.second->wanted) {
+                return !a.second->wanted;
+            }
+            return a.second->distance > b.second->distance;
+        });
+        const auto evict_block = [&](std::pair<Key, Entry*>& candidate) {
+            bytes -= candidate.second->mesh_bytes + candidate.second->voxel_bytes;
+            if (candidate.second->job) {
+                queue.cancel(candidate.second->job->job);
+            }
+            blocks.erase(candidate.first);
+            candidate.second = nullptr;
+            ++statistics.evictions;
+        };
+        for (auto& candidate : candidates) {
+            if (bytes <= settings.memory_budget || candidate.second->wanted) {
+                break;
+            }
+            evict_block(candidate);
+        }
+        for (auto& [key, entry] : candidates) {
+            if (bytes <= settings.memory_budget) {
+                return;
+            }
+            // A running extraction holds on to its voxels until it is done: dropping them frees nothing yet
+            if (entry != nullptr && entry->voxels && !entry->job) {
+                bytes -= entry->voxel_bytes;
+                entry->voxels.reset();
+                entry->voxel_bytes = 0;
+            }
+        }
+        for (auto& candidate : candidates) {
+            if (bytes <= settings.memory_budget) {
+                return;
+            }
+            if (candidate.second != nullptr) {
+                evict_block(candidate);
+            }
+        }
+    }
+
+    void update_statistics(size_t wanted) {
+        statistics.wanted_blocks = wanted;
+        statistics.resident_blocks = 0;
+        statistics.missing_blocks = 0;
+        statistics.in_flight = 0;
+        statistics.voxel_bytes = 0;
+        statistics.mesh_bytes = 0;
+        for (const auto& [key, entry] : blocks) {
+            statistics.resident_blocks += entry.has_mesh() ? 1 : 0;
+            statistics.missing_blocks += entry.wanted && !entry.has_mesh() ? 1 : 0;
+            statistics.in_flight += entry.job ? 1 : 0;
+            statistics.voxel_bytes += entry.voxel_bytes;
+            statistics.mesh_bytes += entry.mesh_bytes;
+        }
+        statistics.queued = queue.pending();
+    }
+
+    SF field;
+    D threshold;
+    StreamingSettings<F> settings;
+    ExtractionOptions options;
+    std::unordered_map<Key, Entry, StreamingBlockKeyHash> blocks;
+    StreamingStats statistics;
+    /// Most bytes the voxels of an extraction take
+    size_t voxel_cache_bytes;
+    // Last, to be destroyed first: jobs hold their own copies of what they read
+    ExtractionQueue<F> queue;
+};